@@ -0,0 +1,123 @@
+/* Display benchmark firmware
+
+   Runs the scenes of the LVGL benchmark demo and then the stress demo on the
+   display path of the clock (disp_buf.c and the ST77XX driver) and prints one
+   JSON object per line for each: frames per second, the p50/p99/max render,
+   flush and wait times from frame_prof, and the bytes sent to the panel. The
+   last line is {"done":true}. Everything else on the console is the usual log.
+   Scene numbers are those of lv_demo_benchmark_run_scene, odd ones are the
+   semi transparent variant of the scene before.
+*/
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include "demos/lv_demos.h"
+#include "st7735.h"
+#include "st77xx_bus_esp.h"
+#include "st77xx_bus_null.h"
+#include "disp_buf.h"
+#include "frame_prof.h"
+
+// How long each benchmark scene and the stress demo are measured
+#define BENCH_SCENE_MS      2000
+#define BENCH_STRESS_MS     10000
+
+#if CONFIG_BENCH_BUS_NULL
+#define BENCH_BUS           "null"
+#define BENCH_BUS_DRIVER    st77xx_bus_null
+#else
+#define BENCH_BUS           "spi"
+#define BENCH_BUS_DRIVER    st77xx_bus_esp
+#endif
+
+static lv_disp_draw_buf_t disp_buf;
+
+static lv_color_t buf_1[DISP_BUF_PX(DISP_BUF)];
+#if DISP_BUF_COUNT(DISP_BUF) == 2
+static lv_color_t buf_2[DISP_BUF_PX(DISP_BUF)];
+#else
+#define buf_2 NULL
+#endif
+
+static lv_disp_drv_t disp_drv;
+
+// Runs LVGL for `ms` and prints what it did as one JSON line
+static void bench_measure(const char *demo, int scene, uint32_t ms)
+{
+    frame_prof_stats_t s;
+    ST77XX_Stats_t bus;
+    lv_mem_monitor_t mem;
+    int64_t start, elapsed;
+    uint32_t fps10;
+
+    frame_prof_reset();
+    ST77XX_ResetStats();
+    start = esp_timer_get_time();
+    do
+    {
+        lv_timer_handler();
+        // Lets the idle task in, for the task watchdog
+        vTaskDelay(1);
+        elapsed = esp_timer_get_time() - start;
+    } while (elapsed < ms * 1000LL);
+
+    frame_prof_stats(&s);
+    ST77XX_GetStats(&bus);
+    lv_mem_monitor(&mem);
+    fps10 = s.frames * 10000000LL / elapsed;
+
+    printf("{\"demo\":\"%s\",\"scene\":%d,\"ms\":%u,\"frames\":%u,\"fps\":%u.%u,"
+           "\"render_us_p50\":%u,\"render_us_p99\":%u,\"render_us_max\":%u,"
+           "\"flush_us_p50\":%u,\"flush_us_p99\":%u,\"flush_us_max\":%u,"
+           "\"wait_us_p50\":%u,\"wait_us_p99\":%u,\"wait_us_max\":%u,"
+           "\"px_p50\":%u,\"bytes\":%u,\"mem_used_pct\":%u}\n",
+           demo, scene, (uint32_t)(elapsed / 1000), s.frames, fps10 / 10, fps10 % 10,
+           s.render_us[0], s.render_us[1], s.render_us[2],
+           s.flush_us[0], s.flush_us[1], s.flush_us[2],
+           s.wait_us[0], s.wait_us[1], s.wait_us[2],
+           s.px[0], bus.bytes, mem.used_pct);
+}
+
+static void bench_init(void)
+{
+    lv_init();
+
+    ST7735_Init(&BENCH_BUS_DRIVER);
+
+    lv_disp_drv_init(&disp_drv);
+    disp_buf_setup(&disp_drv, &disp_buf, DISP_BUF, buf_1, buf_2);
+    disp_drv.flush_cb = disp_buf_flush_cb;
+    disp_drv.hor_res = ST77XX_WIDTH;
+    disp_drv.ver_res = ST77XX_HEIGHT;
+    lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+    frame_prof_start(disp);
+    // Refresh as fast as the display path goes, the numbers are what it can do rather
+    // than the refresh period
+    lv_timer_set_period(disp->refr_timer, 1);
+}
+
+void app_main(void)
+{
+    bench_init();
+    printf("{\"start\":true,\"disp_buf\":\"%s\",\"bus\":\"%s\"}\n", disp_buf_name(DISP_BUF), BENCH_BUS);
+
+    for (int scene = 0;; scene++)
+    {
+        lv_obj_clean(lv_scr_act());
+        lv_demo_benchmark_run_scene(scene);
+        // Past the last scene nothing is created
+        if (lv_obj_get_child_cnt(lv_scr_act()) == 0)
+            break;
+        bench_measure("benchmark", scene, BENCH_SCENE_MS);
+    }
+
+    lv_obj_clean(lv_scr_act());
+    lv_demo_stress();
+    bench_measure("stress", 0, BENCH_STRESS_MS);
+
+    printf("{\"done\":true}\n");
+    while (1)
+        vTaskDelay(portMAX_DELAY);
+}
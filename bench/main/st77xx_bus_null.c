@@ -0,0 +1,88 @@
+/******************************************************************************
+**
+ * \file        st77xx_bus_null.c
+ * \brief       ST77XX transport without a panel
+ * \note        For QEMU, which has no SPI display. The driver does all of its
+ *              work, only the bytes go nowhere.
+ *
+******************************************************************************/
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "st77xx_bus_null.h"
+
+static int st77xx_null_dc = -1;
+
+static void ST77XX_Null_Count(int dc, uint32_t size)
+{
+    st77xx_stats.transactions++;
+    st77xx_stats.bytes += size;
+    if (dc != st77xx_null_dc)
+    {
+        st77xx_stats.dc_toggles++;
+        st77xx_null_dc = dc;
+    }
+}
+
+static void ST77XX_Null_Init(void)
+{
+    st77xx_null_dc = -1;
+}
+
+static void ST77XX_Null_WriteCommand(uint8_t cmd)
+{
+    ST77XX_Null_Count(0, 1);
+}
+
+static void ST77XX_Null_WriteData(const uint8_t *data, uint32_t size)
+{
+    ST77XX_Null_Count(1, size);
+}
+
+static void ST77XX_Null_WriteDataAsync(const uint8_t *data, uint32_t size, ST77XX_DoneCallback done, void *arg)
+{
+    ST77XX_Null_Count(1, size);
+    if (done)
+        done(arg);
+}
+
+// Same transactions as the ESP transport sends for a batched window
+static void ST77XX_Null_WriteWindow(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, bool caset, bool raset)
+{
+    if (caset)
+    {
+        ST77XX_Null_Count(0, 1);
+        ST77XX_Null_Count(1, 4);
+    }
+    if (raset)
+    {
+        ST77XX_Null_Count(0, 1);
+        ST77XX_Null_Count(1, 4);
+    }
+    ST77XX_Null_Count(0, 1);
+}
+
+static void ST77XX_Null_Wait(void)
+{
+}
+
+static void ST77XX_Null_SetLine(bool level)
+{
+}
+
+static void ST77XX_Null_DelayMs(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+const ST77XX_Bus_t st77xx_bus_null = {
+    .init = ST77XX_Null_Init,
+    .write_command = ST77XX_Null_WriteCommand,
+    .write_data = ST77XX_Null_WriteData,
+    .write_data_async = ST77XX_Null_WriteDataAsync,
+    .write_window = ST77XX_Null_WriteWindow,
+    .wait = ST77XX_Null_Wait,
+    .set_reset = ST77XX_Null_SetLine,
+    .set_backlight = ST77XX_Null_SetLine,
+    .delay_ms = ST77XX_Null_DelayMs,
+};
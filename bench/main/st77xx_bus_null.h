@@ -0,0 +1,9 @@
+#ifndef __ST77XX_BUS_NULL_H_
+#define __ST77XX_BUS_NULL_H_
+
+#include "st77xx_bus.h"
+
+// Counts the traffic in st77xx_stats and drops it, async writes complete at once
+extern const ST77XX_Bus_t st77xx_bus_null;
+
+#endif // __ST77XX_BUS_NULL_H_
@@ -0,0 +1,121 @@
+/* Clock discipline against synthetic clocks
+
+   Runs main/clock_disc.c on simulated clocks for CHECK_DAYS days: each has a
+   rate error, optionally a daily temperature swing, and a sync error drawn
+   from a fixed seed, so every run gives the same numbers. The correction is
+   taken out every CHECK_SLEW_S like the firmware does, a sync steps the clock
+   to the measured time and plans the next one. One line per clock:
+
+       clock <name> <syncs/day> <max_error_ms> <rate_error_ppb> ok|FAIL
+
+   syncs/day and the errors are over the last CHECK_TAIL_DAYS, once the rate
+   was learned. A clock fails when its rate is not learned to within
+   CHECK_MAX_RATE_ERROR_PPB, its error went past CLOCK_DISC_MAX_ERROR_US or it
+   syncs more than once an hour, the fixed period the firmware had before. The
+   run exits with 1 if any clock failed.
+*/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "clock_disc.h"
+
+#define CHECK_DAYS                  14
+#define CHECK_TAIL_DAYS             7
+#define CHECK_SLEW_S                16
+#define CHECK_MAX_RATE_ERROR_PPB    1000
+
+typedef struct {
+    const char *name;
+    double ppm;             // rate error of the clock
+    double swing_ppm;       // amplitude of a daily sine on top of it
+    double sync_error_us;   // 1 sigma of the offset a sync measures
+} check_clock_t;
+
+static const check_clock_t check_clocks[] = {
+    {"fast", 37, 0, CLOCK_DISC_SYNC_ERROR_US},
+    {"slow", -150, 0, CLOCK_DISC_SYNC_ERROR_US},
+    {"exact", 0, 0, CLOCK_DISC_SYNC_ERROR_US},
+    {"temperature", 20, 2, CLOCK_DISC_SYNC_ERROR_US},
+    {"noisy", 37, 0, 2 * CLOCK_DISC_SYNC_ERROR_US},
+};
+
+static uint64_t check_seed;
+
+// Gaussian from the sum of 12 uniforms, good enough for sync errors
+static double check_gauss(void)
+{
+    double sum = 0;
+
+    for (int i = 0; i < 12; i++)
+    {
+        check_seed ^= check_seed << 13;
+        check_seed ^= check_seed >> 7;
+        check_seed ^= check_seed << 17;
+        sum += (check_seed >> 11) * (1.0 / 9007199254740992.0);
+    }
+    return sum - 6;
+}
+
+static double check_ppm(const check_clock_t *c, double t)
+{
+    return c->ppm + c->swing_ppm * sin(2 * M_PI * t / 86400);
+}
+
+static int check_run(const check_clock_t *c)
+{
+    clock_disc_t d;
+    double t = 0, clock = 0, max_error = 0;
+    double last_sync = 0, corrected = 0;
+    double tail = (CHECK_DAYS - CHECK_TAIL_DAYS) * 86400.0;
+    double rate_error;
+    int syncs = 0;
+    bool ok;
+
+    check_seed = 0x9E3779B97F4A7C15ULL;
+    clock_disc_init(&d);
+    while (t < CHECK_DAYS * 86400.0)
+    {
+        double next = last_sync + d.interval_s;
+        double step = next - t < CHECK_SLEW_S ? next - t : CHECK_SLEW_S;
+        double due;
+
+        // The clock runs at its rate, the correction due so far is taken out of it
+        clock += step * (1 + check_ppm(c, t) * 1e-6) * 1e6;
+        t += step;
+        due = clock_disc_correction(&d, llround((t - last_sync) * 1e6));
+        clock -= due - corrected;
+        corrected = due;
+
+        if (t >= tail && fabs(clock - t * 1e6) > max_error)
+            max_error = fabs(clock - t * 1e6);
+
+        if (t >= next)
+        {
+            double offset = t * 1e6 + check_gauss() * c->sync_error_us - clock;
+
+            clock_disc_update(&d, llround((t - last_sync) * 1e6), llround(corrected), llround(offset));
+            clock += offset;
+            corrected = 0;
+            last_sync = t;
+            if (t >= tail)
+                syncs++;
+        }
+    }
+
+    rate_error = d.freq_ppb - check_ppm(c, t) * 1000;
+    ok = fabs(rate_error) <= CHECK_MAX_RATE_ERROR_PPB && max_error <= CLOCK_DISC_MAX_ERROR_US &&
+         syncs <= 24 * CHECK_TAIL_DAYS;
+    printf("clock %s %.1f %.0f %.0f %s\n", c->name, (double)syncs / CHECK_TAIL_DAYS, max_error / 1000,
+           rate_error, ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(void)
+{
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(check_clocks) / sizeof(check_clocks[0]); i++)
+        failed |= check_run(&check_clocks[i]);
+    return failed;
+}
@@ -0,0 +1,361 @@
+/* Clock UI on the host
+
+   Runs the clock screen of the firmware (main/clock_ui.c) on LVGL with a
+   framebuffer for a display, a virtual wall clock and a virtual keypad, and
+   plays scripted scenarios on it. LVGL's tick and the wall clock only move when
+   a scenario says so, the frames come out the same on any host. Every
+   snapshot is compared with the golden image of the same name, one line per
+   snapshot and one per scenario:
+
+       frame <scenario>/<snapshot> ok|recorded|MISSING|DIFF <pixels>
+       scenario <scenario> <frames> <render_us_avg> <render_us_max>
+
+   A frame that differs is also written next to its golden image as
+   .actual.ppm, it and a missing golden image make the run exit with 1.
+   --update records all of them again instead. Render times are real time on
+   the host.
+
+       clock_sim [--update] [golden_dir]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include "lvgl.h"
+#include "st77xx.h"
+#include "host_clock.h"
+#include "clock_ui.h"
+
+#define SIM_W       ST77XX_WIDTH
+#define SIM_H       ST77XX_HEIGHT
+#define SIM_LINES   24
+
+// Steps of a scenario
+typedef enum {
+    SIM_END,
+    SIM_SET_TIME,   // wall clock to `arg` ms since the epoch, as a time sync does
+    SIM_RUN,        // `arg` ms pass
+    SIM_KEY,        // key `arg` pressed, 50 ms, released, 50 ms
+    SIM_SNAP,       // compare the screen with golden image `name`
+    SIM_SYNC,       // sync symbol `name`, as the time service sets it
+} sim_op_t;
+
+typedef struct {
+    sim_op_t op;
+    int64_t arg;
+    const char *name;
+} sim_step_t;
+
+typedef struct {
+    const char *name;
+    sim_step_t steps[16];
+} sim_scenario_t;
+
+// 2022-12-31 23:59:58.250 in the firmware's time zone, CST-8
+#define SIM_NEW_YEAR_EVE    1672502398250LL
+
+static const sim_scenario_t sim_scenarios[] = {
+    {"boot", {
+        {SIM_SET_TIME, SIM_NEW_YEAR_EVE},
+        {SIM_RUN, 100},
+        {SIM_SNAP, 0, "boot"},
+    }},
+    {"day_rollover", {
+        {SIM_SET_TIME, SIM_NEW_YEAR_EVE},
+        {SIM_RUN, 1000},
+        {SIM_SNAP, 0, "before"},
+        {SIM_RUN, 1000},
+        {SIM_SNAP, 0, "after"},
+    }},
+    {"keys", {
+        {SIM_SET_TIME, SIM_NEW_YEAR_EVE},
+        {SIM_RUN, 100},
+        {SIM_KEY, LV_KEY_UP},
+        {SIM_KEY, LV_KEY_DOWN},
+        {SIM_KEY, LV_KEY_PREV},
+        {SIM_KEY, LV_KEY_NEXT},
+        {SIM_KEY, LV_KEY_ENTER},
+        {SIM_SNAP, 0, "keys"},
+    }},
+    // Boots at the epoch like the board before SNTP, then the time is set
+    {"sync_jump", {
+        {SIM_SET_TIME, 0},
+        {SIM_SYNC, 0, LV_SYMBOL_REFRESH},
+        {SIM_RUN, 500},
+        {SIM_SNAP, 0, "unsynced"},
+        {SIM_SET_TIME, SIM_NEW_YEAR_EVE},
+        {SIM_SYNC, 0, NULL},
+        {SIM_RUN, 20},
+        {SIM_SNAP, 0, "synced"},
+    }},
+};
+
+static lv_disp_draw_buf_t sim_draw_buf;
+static lv_color_t sim_buf_1[SIM_W * SIM_LINES];
+static lv_color_t sim_buf_2[SIM_W * SIM_LINES];
+static lv_disp_drv_t sim_disp_drv;
+static lv_color_t sim_fb[SIM_W * SIM_H];
+
+static int64_t sim_wall_ms;
+static uint32_t sim_key;
+static bool sim_key_pressed;
+
+static uint32_t sim_frames;
+static uint64_t sim_render_us;
+static uint32_t sim_render_max_us;
+
+// The clock UI reads the wall clock through gettimeofday(), the link sends it here
+// (--wrap in CMakeLists.txt)
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    tv->tv_sec = sim_wall_ms / 1000;
+    tv->tv_usec = sim_wall_ms % 1000 * 1000;
+    return 0;
+}
+
+static uint64_t sim_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sim_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    lv_coord_t w = lv_area_get_width(area);
+
+    for (lv_coord_t y = area->y1; y <= area->y2; y++)
+    {
+        memcpy(&sim_fb[y * SIM_W + area->x1], color_p, w * sizeof(lv_color_t));
+        color_p += w;
+    }
+    lv_disp_flush_ready(drv);
+}
+
+// Times every refresh that draws something
+static void sim_refr_timer(lv_timer_t *timer)
+{
+    lv_disp_t *disp = timer->user_data;
+    uint64_t start;
+    uint32_t us;
+
+    if (disp->inv_p == 0)
+    {
+        _lv_disp_refr_timer(timer);
+        return;
+    }
+    start = sim_now_us();
+    _lv_disp_refr_timer(timer);
+    us = sim_now_us() - start;
+
+    sim_frames++;
+    sim_render_us += us;
+    if (us > sim_render_max_us)
+        sim_render_max_us = us;
+}
+
+static void sim_keypad_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    (void)drv;
+    data->key = sim_key;
+    data->state = sim_key_pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+static void sim_init(void)
+{
+    static lv_indev_drv_t indev_drv;
+    lv_disp_t *disp;
+    lv_indev_t *keypad;
+    lv_group_t *group;
+
+    host_clock_set_source(host_clock_manual);
+    setenv("TZ", "CST-8", 1);
+    tzset();
+    lv_init();
+
+    lv_disp_draw_buf_init(&sim_draw_buf, sim_buf_1, sim_buf_2, SIM_W * SIM_LINES);
+    lv_disp_drv_init(&sim_disp_drv);
+    sim_disp_drv.draw_buf = &sim_draw_buf;
+    sim_disp_drv.flush_cb = sim_flush_cb;
+    sim_disp_drv.hor_res = SIM_W;
+    sim_disp_drv.ver_res = SIM_H;
+    disp = lv_disp_drv_register(&sim_disp_drv);
+    disp->refr_timer->timer_cb = sim_refr_timer;
+
+    lv_indev_drv_init(&indev_drv);
+    indev_drv.type = LV_INDEV_TYPE_KEYPAD;
+    indev_drv.read_cb = sim_keypad_read;
+    keypad = lv_indev_drv_register(&indev_drv);
+    group = lv_group_create();
+    lv_group_set_default(group);
+    lv_indev_set_group(keypad, group);
+
+    clock_ui_create(lv_scr_act());
+}
+
+// Lets `ms` pass, LVGL runs whenever one of its timers is due
+static void sim_run(int64_t ms)
+{
+    while (ms > 0)
+    {
+        uint32_t next = lv_timer_handler();
+        int64_t step = next < 1 ? 1 : next < ms ? next : ms;
+
+        host_clock_advance(step);
+        sim_wall_ms += step;
+        ms -= step;
+    }
+    lv_timer_handler();
+}
+
+static int sim_write_ppm(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f)
+        return -1;
+    fprintf(f, "P6\n%d %d\n255\n", SIM_W, SIM_H);
+    for (int i = 0; i < SIM_W * SIM_H; i++)
+    {
+        uint32_t c = lv_color_to32(sim_fb[i]);
+        uint8_t rgb[3] = {(c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF};
+        fwrite(rgb, 1, 3, f);
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Pixels that differ from the PPM at `path`, -1 if it can't be read
+static int sim_compare_ppm(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    int w, h, max, diff = 0;
+
+    if (!f)
+        return -1;
+    if (fscanf(f, "P6 %d %d %d", &w, &h, &max) != 3 || w != SIM_W || h != SIM_H || fgetc(f) == EOF)
+    {
+        fclose(f);
+        return SIM_W * SIM_H;
+    }
+    for (int i = 0; i < SIM_W * SIM_H; i++)
+    {
+        uint32_t c = lv_color_to32(sim_fb[i]);
+        uint8_t rgb[3];
+
+        if (fread(rgb, 1, 3, f) != 3)
+        {
+            diff += SIM_W * SIM_H - i;
+            break;
+        }
+        if (rgb[0] != ((c >> 16) & 0xFF) || rgb[1] != ((c >> 8) & 0xFF) || rgb[2] != (c & 0xFF))
+            diff++;
+    }
+    fclose(f);
+    return diff;
+}
+
+// Returns 0 unless the frame differs from its golden image or there is none
+static int sim_snap(const char *dir, const char *scenario, const char *name, bool update)
+{
+    char path[512], actual[512];
+    int diff;
+
+    lv_refr_now(NULL);
+    snprintf(path, sizeof(path), "%s/%s_%s.ppm", dir, scenario, name);
+    if (update)
+    {
+        if (sim_write_ppm(path) != 0)
+        {
+            printf("frame %s/%s cannot write %s\n", scenario, name, path);
+            return 1;
+        }
+        printf("frame %s/%s recorded\n", scenario, name);
+        return 0;
+    }
+    diff = sim_compare_ppm(path);
+    if (diff < 0)
+    {
+        printf("frame %s/%s MISSING %s\n", scenario, name, path);
+        return 1;
+    }
+    if (diff == 0)
+    {
+        printf("frame %s/%s ok\n", scenario, name);
+        return 0;
+    }
+    snprintf(actual, sizeof(actual), "%s/%s_%s.actual.ppm", dir, scenario, name);
+    sim_write_ppm(actual);
+    printf("frame %s/%s DIFF %d\n", scenario, name, diff);
+    return 1;
+}
+
+static int sim_play(const sim_scenario_t *s, const char *dir, bool update)
+{
+    int failed = 0;
+
+    sim_frames = 0;
+    sim_render_us = 0;
+    sim_render_max_us = 0;
+    for (const sim_step_t *step = s->steps; step->op != SIM_END; step++)
+    {
+        switch (step->op)
+        {
+        case SIM_SET_TIME:
+            sim_wall_ms = step->arg;
+            clock_ui_time_changed();
+            break;
+
+        case SIM_RUN:
+            sim_run(step->arg);
+            break;
+
+        case SIM_KEY:
+            sim_key = step->arg;
+            sim_key_pressed = true;
+            sim_run(50);
+            sim_key_pressed = false;
+            sim_run(50);
+            break;
+
+        case SIM_SNAP:
+            failed |= sim_snap(dir, s->name, step->name, update);
+            break;
+
+        case SIM_SYNC:
+            clock_ui_set_sync_symbol(step->name);
+            break;
+
+        case SIM_END:
+            break;
+        }
+    }
+    printf("scenario %s %u %u %u\n", s->name, sim_frames,
+           sim_frames ? (uint32_t)(sim_render_us / sim_frames) : 0, sim_render_max_us);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = CLOCK_SIM_GOLDEN_DIR;
+    bool update = false;
+    int failed = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--update") == 0)
+            update = true;
+        else
+            dir = argv[i];
+    }
+    if (update)
+        mkdir(dir, 0777);
+
+    sim_init();
+    for (size_t i = 0; i < sizeof(sim_scenarios) / sizeof(sim_scenarios[0]); i++)
+        failed |= sim_play(&sim_scenarios[i], dir, update);
+    return failed;
+}
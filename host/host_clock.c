@@ -0,0 +1,41 @@
+/******************************************************************************
+**
+ * \file        host_clock.c
+ * \brief       Injectable millisecond clock of the host build
+ *
+******************************************************************************/
+
+#include <time.h>
+#include "host_clock.h"
+
+static uint32_t manual_ms = 0;
+
+static uint32_t host_clock_monotonic(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static uint32_t (*clock_source)(void) = host_clock_monotonic;
+
+uint32_t host_clock_ms(void)
+{
+    return clock_source();
+}
+
+void host_clock_set_source(uint32_t (*source)(void))
+{
+    clock_source = source ? source : host_clock_monotonic;
+}
+
+uint32_t host_clock_manual(void)
+{
+    return manual_ms;
+}
+
+void host_clock_advance(uint32_t ms)
+{
+    manual_ms += ms;
+}
@@ -0,0 +1,22 @@
+#ifndef __HOST_CLOCK_H_
+#define __HOST_CLOCK_H_
+
+#include <stdint.h>
+
+// Millisecond clock of the host build, what esp_timer_get_time() / 1000 is on the board.
+// It is the LVGL tick of host builds, in lv_conf.h:
+//
+//     #define LV_TICK_CUSTOM 1
+//     #define LV_TICK_CUSTOM_INCLUDE "host_clock.h"
+//     #define LV_TICK_CUSTOM_SYS_TIME_EXPR (host_clock_ms())
+//
+// Runs on the host's monotonic clock unless another source is set.
+uint32_t host_clock_ms(void);
+// NULL goes back to the monotonic clock
+void host_clock_set_source(uint32_t (*source)(void));
+// Source that only moves with host_clock_advance, for runs that must not depend on how
+// fast the host is
+uint32_t host_clock_manual(void);
+void host_clock_advance(uint32_t ms);
+
+#endif // __HOST_CLOCK_H_
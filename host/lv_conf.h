@@ -0,0 +1,52 @@
+/* LVGL configuration of the host simulator
+
+   The options of the firmware's sdkconfig that change what ends up on screen,
+   everything else keeps LVGL's defaults. Keep in step with sdkconfig.
+*/
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#include <stdint.h>
+
+#define LV_COLOR_DEPTH                  16
+#define LV_COLOR_16_SWAP                1
+#define LV_COLOR_MIX_ROUND_OFS          128
+
+#define LV_MEM_CUSTOM                   0
+#define LV_MEM_SIZE                     (48U * 1024U)
+
+#define LV_DISP_DEF_REFR_PERIOD         16
+#define LV_INDEV_DEF_READ_PERIOD        16
+#define LV_DPI_DEF                      130
+
+// Manual clock, the simulator moves it (host_clock.h)
+#define LV_TICK_CUSTOM                  1
+#define LV_TICK_CUSTOM_INCLUDE          "host_clock.h"
+#define LV_TICK_CUSTOM_SYS_TIME_EXPR    (host_clock_ms())
+
+#define LV_DRAW_COMPLEX                 1
+#define LV_SHADOW_CACHE_SIZE            0
+#define LV_CIRCLE_CACHE_SIZE            4
+#define LV_IMG_CACHE_DEF_SIZE           0
+#define LV_GRADIENT_MAX_STOPS           2
+#define LV_GRAD_CACHE_DEF_SIZE          0
+
+#define LV_USE_LOG                      0
+#define LV_USE_PERF_MONITOR             0
+#define LV_USE_MEM_MONITOR              0
+#define LV_USE_USER_DATA                1
+
+#define LV_FONT_MONTSERRAT_12           1
+#define LV_FONT_MONTSERRAT_14           1
+#define LV_FONT_MONTSERRAT_16           1
+#define LV_FONT_MONTSERRAT_22           1
+#define LV_FONT_DEFAULT                 &lv_font_montserrat_12
+
+#define LV_TXT_ENC                      LV_TXT_ENC_UTF8
+
+#define LV_USE_THEME_DEFAULT            1
+#define LV_THEME_DEFAULT_DARK           0
+#define LV_THEME_DEFAULT_GROW           1
+#define LV_THEME_DEFAULT_TRANSITION_TIME 80
+
+#endif // LV_CONF_H
@@ -0,0 +1,341 @@
+/******************************************************************************
+**
+ * \file        st77xx_bus_host.c
+ * \brief       Host transport of the ST77XX driver
+ * \note        Nothing leaves the process: the command stream is decoded into
+ *              an emulated GRAM and the traffic is counted the same way the
+ *              ESP SPI transport counts it, so throughput can be tracked
+ *              without a board.
+ *
+******************************************************************************/
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "st77xx.h"
+#include "st77xx_bus_host.h"
+
+// GRAM in the panel's native orientation
+#if ST77XX_ROTATION & ST77XX_MADCTL_MV
+#define GRAM_W  ST77XX_HEIGHT
+#define GRAM_H  ST77XX_WIDTH
+#else
+#define GRAM_W  ST77XX_WIDTH
+#define GRAM_H  ST77XX_HEIGHT
+#endif
+
+static uint16_t gram[GRAM_H][GRAM_W];
+
+static int last_dc = -1;
+static uint32_t delay_total = 0;
+
+// Command decoder state
+static uint8_t cur_cmd = ST77XX_NOP;
+static uint8_t params[4];
+static uint8_t param_idx = 0;
+static uint8_t madctl = 0;
+static uint8_t colmod = 0x05;
+static uint16_t win_xs = 0, win_xe = GRAM_W - 1, win_ys = 0, win_ye = GRAM_H - 1;
+static uint16_t cur_x = 0, cur_y = 0;
+static uint8_t pix_hi;
+static bool pix_half = false;
+// RGB444 decoding, nibbles of the pixel being assembled
+static uint16_t pix_bits;
+static uint8_t pix_nibbles = 0;
+
+static void ST77XX_Host_Count(int dc, uint32_t size)
+{
+    st77xx_stats.transactions++;
+    st77xx_stats.bytes += size;
+    if (dc != last_dc)
+    {
+        st77xx_stats.dc_toggles++;
+        last_dc = dc;
+    }
+}
+
+// Address counter position to the GRAM cell it lands in, false if off the panel
+static bool ST77XX_Host_Map(uint16_t col, uint16_t row, uint16_t *gx, uint16_t *gy)
+{
+    uint16_t x, y;
+
+    if (col < ST77XX_XSTART || row < ST77XX_YSTART)
+        return false;
+    col -= ST77XX_XSTART;
+    row -= ST77XX_YSTART;
+
+    if (madctl & ST77XX_MADCTL_MV)
+    {
+        x = row;
+        y = col;
+    }
+    else
+    {
+        x = col;
+        y = row;
+    }
+    if (x >= GRAM_W || y >= GRAM_H)
+        return false;
+    if (madctl & ST77XX_MADCTL_MX)
+        x = GRAM_W - 1 - x;
+    if (madctl & ST77XX_MADCTL_MY)
+        y = GRAM_H - 1 - y;
+
+    *gx = x;
+    *gy = y;
+    return true;
+}
+
+static void ST77XX_Host_PutPixel(uint16_t color)
+{
+    uint16_t gx, gy;
+
+    if (ST77XX_Host_Map(cur_x, cur_y, &gx, &gy))
+    {
+        gram[gy][gx] = color;
+    }
+    if (++cur_x > win_xe)
+    {
+        cur_x = win_xs;
+        if (++cur_y > win_ye)
+        {
+            cur_y = win_ys;
+        }
+    }
+}
+
+static void ST77XX_Host_DataByte(uint8_t b)
+{
+    switch (cur_cmd)
+    {
+    case ST77XX_CASET:
+    case ST77XX_RASET:
+        if (param_idx < 4)
+        {
+            params[param_idx++] = b;
+        }
+        if (param_idx == 4)
+        {
+            uint16_t s = (params[0] << 8) | params[1];
+            uint16_t e = (params[2] << 8) | params[3];
+            if (cur_cmd == ST77XX_CASET)
+            {
+                win_xs = s;
+                win_xe = e;
+            }
+            else
+            {
+                win_ys = s;
+                win_ye = e;
+            }
+        }
+        break;
+
+    case ST77XX_MADCTL:
+        madctl = b;
+        break;
+
+    case ST77XX_COLMOD:
+        colmod = b;
+        break;
+
+    case ST77XX_RAMWR:
+        if (colmod == ST77XX_COLMOD_444)
+        {
+            // 12-bit pixels, 2 in 3 bytes, widened to RGB565 the way the panel does
+            uint8_t i;
+            for (i = 0; i < 2; i++)
+            {
+                pix_bits = (pix_bits << 4) | ((i == 0 ? b >> 4 : b) & 0x0F);
+                if (++pix_nibbles == 3)
+                {
+                    uint16_t r = (pix_bits >> 8) & 0xF, g = (pix_bits >> 4) & 0xF, bl = pix_bits & 0xF;
+                    ST77XX_Host_PutPixel(((r << 1 | r >> 3) << 11) | ((g << 2 | g >> 2) << 5) | (bl << 1 | bl >> 3));
+                    pix_nibbles = 0;
+                    pix_bits = 0;
+                }
+            }
+            break;
+        }
+        // 16-bit pixels, high byte first
+        if (!pix_half)
+        {
+            pix_hi = b;
+            pix_half = true;
+        }
+        else
+        {
+            ST77XX_Host_PutPixel((pix_hi << 8) | b);
+            pix_half = false;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void ST77XX_Host_Init(void)
+{
+    memset(gram, 0, sizeof(gram));
+    last_dc = -1;
+    delay_total = 0;
+}
+
+static void ST77XX_Host_WriteCommand(uint8_t cmd)
+{
+    ST77XX_Host_Count(0, 1);
+    cur_cmd = cmd;
+    param_idx = 0;
+    if (cmd == ST77XX_RAMWR)
+    {
+        cur_x = win_xs;
+        cur_y = win_ys;
+        pix_half = false;
+        pix_nibbles = 0;
+        pix_bits = 0;
+    }
+    else if (cmd == ST77XX_SWRESET)
+    {
+        madctl = 0;
+    }
+}
+
+static void ST77XX_Host_Send(const uint8_t *data, uint32_t size)
+{
+    ST77XX_Host_Count(1, size);
+    while (size--)
+    {
+        ST77XX_Host_DataByte(*data++);
+    }
+}
+
+// The ESP transport can't take more in one blocking write
+static void ST77XX_Host_WriteData(const uint8_t *data, uint32_t size)
+{
+    assert(size <= ST77XX_BUS_MAX_WRITE);
+    ST77XX_Host_Send(data, size);
+}
+
+static void ST77XX_Host_WriteDataAsync(const uint8_t *data, uint32_t size, ST77XX_DoneCallback done, void *arg)
+{
+    ST77XX_Host_Send(data, size);
+    if (done)
+        done(arg);
+}
+
+static void ST77XX_Host_WriteDataRepeat(const uint8_t *data, uint32_t size, uint32_t count)
+{
+    assert(size <= ST77XX_BUS_MAX_WRITE);
+    while (count--)
+    {
+        ST77XX_Host_Send(data, size);
+    }
+}
+
+// Same transactions as the ESP transport sends for a batched window
+static void ST77XX_Host_WriteWindow(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, bool caset, bool raset)
+{
+    uint8_t data[4];
+
+    if (caset)
+    {
+        data[0] = x1 >> 8;
+        data[1] = x1 & 0xFF;
+        data[2] = x2 >> 8;
+        data[3] = x2 & 0xFF;
+        ST77XX_Host_WriteCommand(ST77XX_CASET);
+        ST77XX_Host_WriteData(data, sizeof(data));
+    }
+    if (raset)
+    {
+        data[0] = y1 >> 8;
+        data[1] = y1 & 0xFF;
+        data[2] = y2 >> 8;
+        data[3] = y2 & 0xFF;
+        ST77XX_Host_WriteCommand(ST77XX_RASET);
+        ST77XX_Host_WriteData(data, sizeof(data));
+    }
+    ST77XX_Host_WriteCommand(ST77XX_RAMWR);
+}
+
+static void ST77XX_Host_Wait(void)
+{
+}
+
+static void ST77XX_Host_SetReset(bool level)
+{
+    if (!level)
+    {
+        madctl = 0;
+        colmod = 0x06;
+        cur_cmd = ST77XX_NOP;
+    }
+}
+
+static void ST77XX_Host_SetBacklight(bool on)
+{
+    (void)on;
+}
+
+static void ST77XX_Host_DelayMs(uint32_t ms)
+{
+    delay_total += ms;
+}
+
+uint16_t ST77XX_Host_GetPixel(uint16_t x, uint16_t y)
+{
+    uint16_t gx, gy;
+
+    if (!ST77XX_Host_Map(x + ST77XX_XSTART, y + ST77XX_YSTART, &gx, &gy))
+        return 0;
+    return gram[gy][gx];
+}
+
+uint32_t ST77XX_Host_DelayTotal(void)
+{
+    return delay_total;
+}
+
+int ST77XX_Host_DumpPPM(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    uint16_t x, y, c;
+    uint8_t rgb[3], t;
+
+    if (!f)
+        return -1;
+
+    fprintf(f, "P6\n%d %d\n255\n", ST77XX_WIDTH, ST77XX_HEIGHT);
+    for (y = 0; y < ST77XX_HEIGHT; y++)
+    {
+        for (x = 0; x < ST77XX_WIDTH; x++)
+        {
+            c = ST77XX_Host_GetPixel(x, y);
+            rgb[0] = ((c >> 11) & 0x1F) * 255 / 31;
+            rgb[1] = ((c >> 5) & 0x3F) * 255 / 63;
+            rgb[2] = (c & 0x1F) * 255 / 31;
+            if (madctl & ST77XX_MADCTL_BGR)
+            {
+                t = rgb[0];
+                rgb[0] = rgb[2];
+                rgb[2] = t;
+            }
+            fwrite(rgb, 1, sizeof(rgb), f);
+        }
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+const ST77XX_Bus_t st77xx_bus_host = {
+    .init = ST77XX_Host_Init,
+    .write_command = ST77XX_Host_WriteCommand,
+    .write_data = ST77XX_Host_WriteData,
+    .write_data_async = ST77XX_Host_WriteDataAsync,
+    .write_data_repeat = ST77XX_Host_WriteDataRepeat,
+    .write_window = ST77XX_Host_WriteWindow,
+    .wait = ST77XX_Host_Wait,
+    .set_reset = ST77XX_Host_SetReset,
+    .set_backlight = ST77XX_Host_SetBacklight,
+    .delay_ms = ST77XX_Host_DelayMs,
+};
@@ -0,0 +1,17 @@
+#ifndef __ST77XX_BUS_HOST_H_
+#define __ST77XX_BUS_HOST_H_
+
+#include "st77xx_bus.h"
+
+// Records everything sent to it and decodes the window, RAMWR, MADCTL and COLMOD
+// commands into an emulated GRAM
+extern const ST77XX_Bus_t st77xx_bus_host;
+
+// Pixel at panel coordinates (x, y) as seen with the current MADCTL, RGB565
+uint16_t ST77XX_Host_GetPixel(uint16_t x, uint16_t y);
+// Milliseconds of delay the driver asked for, no real time passes on the host
+uint32_t ST77XX_Host_DelayTotal(void);
+// Writes the emulated screen as a binary PPM, returns 0 on success
+int ST77XX_Host_DumpPPM(const char *path);
+
+#endif // __ST77XX_BUS_HOST_H_
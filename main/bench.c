@@ -0,0 +1,683 @@
+/* Display benchmarks
+
+   Run once at boot when CLOCK_BENCH is set in bench.h, every result is
+   printed on the console.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "st77xx.h"
+#include "clock_atlas.h"
+#include "clock_digits.h"
+#include "clock_fmt.h"
+#include "font_chain.h"
+#include "font_cache.h"
+#include "disp_buf.h"
+#include "bench.h"
+
+#define BENCH_FRAMES 50
+#define BENCH_MONITOR_PERIOD 5000
+
+static const char *TAG = "bench";
+
+// The flush callback as it was before the async pipeline, for comparison
+static void bench_flush_sync_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    ST77XX_DrawImage(area->x1, area->y1, area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, (uint16_t *)color_p);
+    lv_disp_flush_ready(drv);
+}
+
+// The flush without the shadow diff, every frame goes out whole
+static void IRAM_ATTR bench_flush_done(void *arg)
+{
+    lv_disp_flush_ready((lv_disp_drv_t *)arg);
+}
+
+static void bench_flush_async_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    ST77XX_DrawImageAsync(area->x1, area->y1, area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, (uint16_t *)color_p,
+                          bench_flush_done, drv);
+}
+
+// Redraws `obj` `frames` times, returns frames per second x10
+static uint32_t bench_fps_obj(lv_disp_t *disp, lv_obj_t *obj, int frames)
+{
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < frames; i++)
+    {
+        lv_obj_invalidate(obj);
+        lv_refr_now(disp);
+    }
+    ST77XX_WaitAsync();
+    int64_t elapsed = esp_timer_get_time() - start;
+    return (uint32_t)(frames * 10000000LL / elapsed);
+}
+
+// Redraws the whole screen `frames` times, returns frames per second x10
+static uint32_t bench_fps(lv_disp_t *disp, int frames)
+{
+    return bench_fps_obj(disp, lv_scr_act(), frames);
+}
+
+typedef void (*bench_flush_t)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+
+// Runs `fn(disp, arg)` with `cb` as the flush callback of `disp`, then puts the one it had back
+static void bench_with_flush(lv_disp_t *disp, bench_flush_t cb, void (*fn)(lv_disp_t *, void *), void *arg)
+{
+    bench_flush_t flush_cb = disp->driver->flush_cb;
+
+    disp->driver->flush_cb = cb;
+    fn(disp, arg);
+    disp->driver->flush_cb = flush_cb;
+}
+
+// A scene that takes some time to render, so there is something to overlap with the transfer
+static lv_obj_t *bench_scene_create(void)
+{
+    lv_obj_t *scene = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(scene, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_style_bg_color(scene, lv_palette_main(LV_PALETTE_BLUE), 0);
+    lv_obj_set_style_bg_grad_color(scene, lv_palette_main(LV_PALETTE_RED), 0);
+    lv_obj_set_style_bg_grad_dir(scene, LV_GRAD_DIR_VER, 0);
+    lv_obj_set_style_radius(scene, 10, 0);
+
+    lv_obj_t *label = lv_label_create(scene);
+    lv_label_set_text(label, "12:34:56.789\nbenchmark");
+    lv_obj_center(label);
+    return scene;
+}
+
+// Full screen frames per second x10 into `fps`
+static void bench_fps_full(lv_disp_t *disp, void *fps)
+{
+    *(uint32_t *)fps = bench_fps(disp, BENCH_FRAMES);
+}
+
+static void bench_flush_overlap(lv_disp_t *disp)
+{
+    lv_obj_t *scene = bench_scene_create();
+    uint32_t fps_sync, fps_async;
+
+    bench_with_flush(disp, bench_flush_sync_cb, bench_fps_full, &fps_sync);
+    bench_fps_full(disp, &fps_async);
+
+    ESP_LOGI(TAG, "full screen flush: blocking %u.%u fps, async %u.%u fps",
+             fps_sync / 10, fps_sync % 10, fps_async / 10, fps_async % 10);
+
+    lv_obj_del(scene);
+}
+
+// Small flushes, about the size of one clock digit, where window setup dominates
+static void bench_small_flush(bool batching)
+{
+    static uint16_t digit[12 * 16];
+    ST77XX_Stats_t stats;
+
+    ST77XX_SetWindowBatching(batching);
+    ST77XX_ResetStats();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        // alternate between two places so the window always changes
+        ST77XX_DrawImage((i & 1) * 12, 0, 12, 16, digit);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    ST77XX_GetStats(&stats);
+
+    ESP_LOGI(TAG, "12x16 flush, window batching %s: %u transactions, %u us per flush",
+             batching ? "on" : "off", stats.transactions / BENCH_FRAMES, (uint32_t)(elapsed / BENCH_FRAMES));
+}
+
+static void bench_primitive(const char *name, void (*draw)(void))
+{
+    ST77XX_Stats_t stats;
+
+    ST77XX_ResetStats();
+    int64_t start = esp_timer_get_time();
+    draw();
+    int64_t elapsed = esp_timer_get_time() - start;
+    ST77XX_GetStats(&stats);
+    ESP_LOGI(TAG, "%s: %u transactions, %u bytes, %u us", name, stats.transactions, stats.bytes, (uint32_t)elapsed);
+}
+
+static void bench_draw_line(void)
+{
+    ST77XX_DrawLine(0, 10, ST77XX_WIDTH - 1, 30, ST77XX_RED);
+}
+
+static void bench_draw_rect(void)
+{
+    ST77XX_DrawRectangle(10, 40, 60, 90, ST77XX_GREEN);
+}
+
+static void bench_draw_circle(void)
+{
+    ST77XX_DrawCircle(100, 64, 30, ST77XX_YELLOW);
+}
+
+// The circle as it was drawn before the span rasterizer, for comparison
+static void bench_draw_circle_points(void)
+{
+    int a = 0, b = 30;
+    while (a <= b)
+    {
+        ST77XX_DrawPoint(100 - b, 64 - a, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 - b, 64 + a, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 + b, 64 - a, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 + b, 64 + a, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 + a, 64 - b, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 - a, 64 - b, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 + a, 64 + b, ST77XX_YELLOW);
+        ST77XX_DrawPoint(100 - a, 64 + b, ST77XX_YELLOW);
+        a++;
+        if ((a * a + b * b) > 30 * 30)
+        {
+            b--;
+        }
+    }
+}
+
+static void bench_fill_circle(void)
+{
+    ST77XX_FillCircle(100, 64, 30, ST77XX_BLUE);
+}
+
+static void bench_primitives(void)
+{
+    bench_primitive("line", bench_draw_line);
+    bench_primitive("rectangle", bench_draw_rect);
+    bench_primitive("circle, points", bench_draw_circle_points);
+    bench_primitive("circle", bench_draw_circle);
+    bench_primitive("fill circle", bench_fill_circle);
+}
+
+// Full screen fills against the time the pixels alone take on the 40 MHz wire
+static void bench_fill(void)
+{
+    uint32_t wire_us = ST77XX_WIDTH * ST77XX_HEIGHT * 16 / 40;
+    int64_t start, clear, checker, gradient;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        ST77XX_Fill(0, 0, ST77XX_WIDTH, ST77XX_HEIGHT, (i & 1) ? ST77XX_WHITE : ST77XX_BLACK);
+    }
+    ST77XX_WaitAsync();
+    clear = (esp_timer_get_time() - start) / BENCH_FRAMES;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        ST77XX_FillChecker(0, 0, ST77XX_WIDTH, ST77XX_HEIGHT, 8, ST77XX_WHITE, ST77XX_BLACK);
+    }
+    ST77XX_WaitAsync();
+    checker = (esp_timer_get_time() - start) / BENCH_FRAMES;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        ST77XX_FillGradient(0, 0, ST77XX_WIDTH, ST77XX_HEIGHT, ST77XX_BLUE, ST77XX_RED, true);
+    }
+    ST77XX_WaitAsync();
+    gradient = (esp_timer_get_time() - start) / BENCH_FRAMES;
+
+    ESP_LOGI(TAG, "full screen fill, wire time %u us: clear %u us, checker %u us, gradient %u us",
+             wire_us, (uint32_t)clear, (uint32_t)checker, (uint32_t)gradient);
+}
+
+// Glyphs per second of ST77XX_DrawChar, wire time included
+static void bench_glyphs(void)
+{
+    static FontDef_t *const fonts[] = {
+        &Font_5x7, &Font_6x8, &Font_6x12, &Font_7x10, &Font_8x16,
+        &Font_11x18, &Font_12x24, &Font_16x26, &Font_16x32,
+    };
+    const int count = 200;
+
+    for (int f = 0; f < sizeof(fonts) / sizeof(fonts[0]); f++)
+    {
+        FontDef_t *font = fonts[f];
+        int cols = ST77XX_WIDTH / font->width, rows = ST77XX_HEIGHT / font->height;
+
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < count; i++)
+        {
+            ST77XX_DrawChar((i % cols) * font->width, (i / cols % rows) * font->height,
+                            '!' + i % 94, font, ST77XX_WHITE, ST77XX_BLACK);
+        }
+        int64_t elapsed = esp_timer_get_time() - start;
+
+        ESP_LOGI(TAG, "glyphs %ux%u: %u glyphs/s", font->width, font->height,
+                 (uint32_t)(count * 1000000LL / elapsed));
+    }
+}
+
+// A status line, one window for the whole string
+static void bench_string(void)
+{
+    ST77XX_Stats_t stats;
+
+    ST77XX_ResetStats();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        ST77XX_DrawString(0, 0, "2022-05-01 12:34:56 WiFi", &Font_6x8, ST77XX_WHITE, ST77XX_BLACK);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    ST77XX_GetStats(&stats);
+
+    ESP_LOGI(TAG, "24 char 6x8 string: %u transactions, %u us per string",
+             stats.transactions / BENCH_FRAMES, (uint32_t)(elapsed / BENCH_FRAMES));
+}
+
+// A seconds clock on the driver alone, only the digits that change are drawn
+static void bench_clock_digits(void)
+{
+    ST77XX_GlyphStats_t gstats;
+    char prev[12] = "", text[12];
+    const int ticks = 600;
+
+    ST77XX_ResetGlyphStats();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < ticks; i++)
+    {
+        sprintf(text, "%02d:%02d:%02d", 12, i / 60, i % 60);
+        ST77XX_UpdateString(0, 0, prev, text, &Font_11x18, ST77XX_WHITE, ST77XX_BLACK);
+        strcpy(prev, text);
+    }
+    ST77XX_WaitAsync();
+    int64_t elapsed = esp_timer_get_time() - start;
+    ST77XX_GetGlyphStats(&gstats);
+
+    ESP_LOGI(TAG, "11x18 clock: %u us per tick, glyph cache %u hits %u misses %u evictions %u bypass",
+             (uint32_t)(elapsed / ticks), gstats.hits, gstats.misses, gstats.evictions, gstats.bypass);
+}
+
+// Renders without sending anything, to time LVGL alone
+static void bench_flush_null_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    lv_disp_flush_ready(drv);
+}
+
+typedef struct {
+    lv_obj_t *label, *digits;
+    int64_t elapsed[2];     // label, widget
+} bench_clock_text_t;
+
+static void bench_clock_text_frames(lv_disp_t *disp, void *arg)
+{
+    bench_clock_text_t *t = arg;
+    char text[16];
+
+    for (int widget = 0; widget < 2; widget++)
+    {
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < BENCH_FRAMES * 4; i++)
+        {
+            sprintf(text, "12:34:%02d.%03d", i / 100, i * 10 % 1000);
+            if (widget)
+                clock_digits_set_text(t->digits, text);
+            else
+                lv_label_set_text(t->label, text);
+            lv_refr_now(disp);
+        }
+        t->elapsed[widget] = esp_timer_get_time() - start;
+    }
+}
+
+// A clock label ticking at the millisecond against the atlas widget, render time only
+static void bench_clock_text(lv_disp_t *disp)
+{
+    lv_obj_t *scene = lv_obj_create(lv_scr_act());
+    lv_obj_t *label = lv_label_create(scene);
+    lv_obj_t *digits = clock_digits_create(scene);
+    bench_clock_text_t t = {.label = label, .digits = digits};
+
+    lv_obj_remove_style_all(scene);
+    lv_obj_set_size(scene, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_style_bg_opa(scene, LV_OPA_COVER, 0);
+    lv_obj_set_style_bg_color(scene, lv_color_hex(clock_atlas.bg), 0);
+    lv_obj_set_style_text_font(label, &lv_font_montserrat_22, 0);
+    lv_obj_set_style_text_color(label, lv_color_hex(clock_atlas.fg), 0);
+    lv_obj_align(label, LV_ALIGN_TOP_LEFT, 5, 5);
+    lv_obj_align(digits, LV_ALIGN_TOP_LEFT, 5, 40);
+    lv_refr_now(disp);
+
+    bench_with_flush(disp, bench_flush_null_cb, bench_clock_text_frames, &t);
+
+    ESP_LOGI(TAG, "clock text render: montserrat_22 label %u us per frame, atlas widget %u us per frame",
+             (uint32_t)(t.elapsed[0] / (BENCH_FRAMES * 4)), (uint32_t)(t.elapsed[1] / (BENCH_FRAMES * 4)));
+    lv_obj_del(scene);
+}
+
+// Time per glyph lookup of the date text, descriptor and bitmap. The characters are taken
+// in turn, so the last glyph cache of the fmt_txt fonts doesn't help.
+static uint32_t bench_font_lookup_ns(const lv_font_t *font, const uint32_t *letters, int count)
+{
+    lv_font_glyph_dsc_t dsc;
+    int64_t start = esp_timer_get_time();
+
+    for (int i = 0; i < BENCH_FRAMES * 40; i++)
+    {
+        for (int j = 0; j < count; j++)
+        {
+            if (lv_font_get_glyph_dsc(font, &dsc, letters[j], 0))
+                lv_font_get_glyph_bitmap(font, letters[j]);
+        }
+    }
+    return (esp_timer_get_time() - start) * 1000 / (BENCH_FRAMES * 40 * count);
+}
+
+// The date font cut down at build time against the full CJK font, and the chain falling
+// back to montserrat for a letter the subset doesn't have
+static void bench_font_lookup(void)
+{
+    static const lv_font_t *const fonts[] = {&clock_font_date_subset, &lv_font_montserrat_16};
+    static font_chain_t chain;
+    static font_cache_t cache;
+    const lv_font_t *date = font_chain_init(&chain, fonts, sizeof(fonts) / sizeof(fonts[0]));
+    const char *text = "2022年12月31 星期六";
+    uint32_t letters[CLOCK_DATE_MAX], fallback = 'A';
+    uint32_t i = 0;
+    int count = 0;
+
+    while (text[i])
+        letters[count++] = _lv_txt_encoded_next(text, &i);
+
+#if LV_FONT_SIMSUN_16_CJK
+    ESP_LOGI(TAG, "date glyph lookup: simsun_16_cjk %u ns, subset %u ns, chain %u ns",
+             bench_font_lookup_ns(&lv_font_simsun_16_cjk, letters, count),
+             bench_font_lookup_ns(&clock_font_date_subset, letters, count),
+             bench_font_lookup_ns(date, letters, count));
+#else
+    ESP_LOGI(TAG, "date glyph lookup: subset %u ns, chain %u ns",
+             bench_font_lookup_ns(&clock_font_date_subset, letters, count),
+             bench_font_lookup_ns(date, letters, count));
+#endif
+    ESP_LOGI(TAG, "date glyph lookup: fallback to montserrat_16 %u ns, subset through the glyph cache %u ns",
+             bench_font_lookup_ns(date, &fallback, 1),
+             bench_font_lookup_ns(font_cache_init(&cache, &clock_font_date_subset), letters, count));
+}
+
+typedef struct {
+    lv_obj_t *label;
+    const lv_font_t *fonts[2];  // bare, through the cache
+    int64_t elapsed[2];
+} bench_font_cache_t;
+
+static void bench_font_cache_frames(lv_disp_t *disp, void *arg)
+{
+    bench_font_cache_t *c = arg;
+    char text[CLOCK_DATE_MAX];
+    struct tm tm = {.tm_year = 122};
+
+    for (int cached = 0; cached < 2; cached++)
+    {
+        int64_t start = esp_timer_get_time();
+
+        lv_obj_set_style_text_font(c->label, c->fonts[cached], 0);
+        for (int i = 0; i < BENCH_FRAMES * 2; i++)
+        {
+            // A new day every frame, the weekday characters change too
+            tm.tm_mon = i % 12;
+            tm.tm_mday = i % 28 + 1;
+            tm.tm_wday = i % 7;
+            clock_fmt_date(text, &tm);
+            lv_label_set_text(c->label, text);
+            lv_refr_now(disp);
+        }
+        c->elapsed[cached] = esp_timer_get_time() - start;
+    }
+}
+
+// Date label redraws through the glyph cache against the bare font, render time only, and
+// how many of the lookups LVGL made during layout and drawing the cache answered
+static void bench_font_cache(lv_disp_t *disp)
+{
+#if LV_FONT_SIMSUN_16_CJK
+    const lv_font_t *source = &lv_font_simsun_16_cjk;
+#else
+    const lv_font_t *source = &clock_font_date_subset;
+#endif
+    static font_cache_t cache;
+    lv_obj_t *scene = lv_obj_create(lv_scr_act());
+    lv_obj_t *label = lv_label_create(scene);
+    bench_font_cache_t c = {.label = label, .fonts = {source, font_cache_init(&cache, source)}};
+
+    lv_obj_remove_style_all(scene);
+    lv_obj_set_size(scene, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_style_bg_opa(scene, LV_OPA_COVER, 0);
+    lv_obj_align(label, LV_ALIGN_TOP_LEFT, 5, 5);
+    lv_refr_now(disp);
+
+    bench_with_flush(disp, bench_flush_null_cb, bench_font_cache_frames, &c);
+
+    ESP_LOGI(TAG, "date label render: %u us per frame, %u us with the glyph cache",
+             (uint32_t)(c.elapsed[0] / (BENCH_FRAMES * 2)), (uint32_t)(c.elapsed[1] / (BENCH_FRAMES * 2)));
+    ESP_LOGI(TAG, "glyph cache: %u of %u descriptors, %u of %u bitmaps from the cache",
+             cache.hits, cache.hits + cache.misses, cache.bitmap_hits, cache.bitmap_hits + cache.bitmap_misses);
+    lv_obj_del(scene);
+}
+
+static void bench_wire_format_fps(lv_disp_t *disp, void *digits)
+{
+    for (int rgb444 = 0; rgb444 < 2; rgb444++)
+    {
+        ST77XX_SetRGB444(rgb444);
+        uint32_t fps_full = bench_fps(disp, BENCH_FRAMES);
+        uint32_t fps_part = bench_fps_obj(disp, digits, BENCH_FRAMES * 4);
+        ESP_LOGI(TAG, "%s: full screen %u.%u fps, 80x24 area %u.%u fps", rgb444 ? "RGB444" : "RGB565",
+                 fps_full / 10, fps_full % 10, fps_part / 10, fps_part % 10);
+    }
+    ST77XX_SetRGB444(ST77XX_RGB444);
+}
+
+// Full screen and a clock sized area, with RGB565 and RGB444 on the wire
+static void bench_wire_format(lv_disp_t *disp)
+{
+    lv_obj_t *scene = bench_scene_create();
+    lv_obj_t *digits = lv_obj_create(scene);
+
+    lv_obj_set_size(digits, 80, 24);
+    lv_obj_center(digits);
+    bench_with_flush(disp, bench_flush_async_cb, bench_wire_format_fps, digits);
+    lv_obj_del(scene);
+}
+
+// Frames per second x10 and wire bytes per frame of `frames` refreshes, `step` changes the
+// scene before each
+static uint32_t bench_scene_fps(lv_disp_t *disp, void (*step)(int), int frames, uint32_t *bytes)
+{
+    ST77XX_Stats_t stats;
+
+    ST77XX_ResetStats();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < frames; i++)
+    {
+        step(i);
+        lv_refr_now(disp);
+    }
+    ST77XX_WaitAsync();
+    int64_t elapsed = esp_timer_get_time() - start;
+    ST77XX_GetStats(&stats);
+    *bytes = stats.bytes / frames;
+    return (uint32_t)(frames * 10000000LL / elapsed);
+}
+
+static lv_obj_t *bench_buf_scene, *bench_buf_label;
+
+// Every pixel changes
+static void bench_step_full(int i)
+{
+    lv_obj_set_style_bg_color(bench_buf_scene, lv_palette_main((i & 1) ? LV_PALETTE_GREEN : LV_PALETTE_BLUE), 0);
+}
+
+// A clock ticking
+static void bench_step_clock(int i)
+{
+    lv_label_set_text_fmt(bench_buf_label, "12:34:56.%03d", i * 10 % 1000);
+}
+
+// Every draw buffer strategy on the same scenes, with the buffers taken from the heap
+static void bench_disp_buf(lv_disp_t *disp)
+{
+    lv_disp_drv_t *drv = disp->driver;
+    lv_disp_draw_buf_t *saved = drv->draw_buf, draw_buf;
+    bool full_refresh = drv->full_refresh, direct_mode = drv->direct_mode;
+    uint32_t fps_full, fps_clock, bytes_full, bytes_clock;
+
+    bench_buf_scene = bench_scene_create();
+    bench_buf_label = lv_obj_get_child(bench_buf_scene, 0);
+    for (int s = 0; s < DISP_BUF_STRATEGIES; s++)
+    {
+        size_t size = DISP_BUF_PX(s) * sizeof(lv_color_t);
+        lv_color_t *buf1 = heap_caps_malloc(size, MALLOC_CAP_DMA);
+        lv_color_t *buf2 = DISP_BUF_COUNT(s) == 2 ? heap_caps_malloc(size, MALLOC_CAP_DMA) : NULL;
+
+        if (buf1 && (buf2 || DISP_BUF_COUNT(s) == 1))
+        {
+            disp_buf_setup(drv, &draw_buf, s, buf1, buf2);
+            lv_disp_drv_update(disp, drv);
+            lv_refr_now(disp);
+            fps_full = bench_scene_fps(disp, bench_step_full, BENCH_FRAMES, &bytes_full);
+            fps_clock = bench_scene_fps(disp, bench_step_clock, BENCH_FRAMES * 4, &bytes_clock);
+            ESP_LOGI(TAG, "%s: %u bytes of buffers, full screen %u.%u fps %u bytes/frame, clock %u.%u fps %u bytes/frame",
+                     disp_buf_name(s), (unsigned)(size * DISP_BUF_COUNT(s)), fps_full / 10, fps_full % 10, bytes_full,
+                     fps_clock / 10, fps_clock % 10, bytes_clock);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%s: not enough memory for %u bytes of buffers", disp_buf_name(s),
+                     (unsigned)(size * DISP_BUF_COUNT(s)));
+        }
+        // Back on the firmware buffers before these go
+        drv->draw_buf = saved;
+        drv->full_refresh = full_refresh;
+        drv->direct_mode = direct_mode;
+        lv_disp_drv_update(disp, drv);
+        free(buf1);
+        free(buf2);
+    }
+    lv_obj_del(bench_buf_scene);
+}
+
+static int64_t bench_busy_us = 0;
+static uint32_t bench_flushed_px = 0;
+static uint32_t bench_allocs = 0;
+
+#if CLOCK_BENCH
+// The linker sends every call to lv_mem_alloc and lv_mem_realloc from outside lv_mem.c
+// through these (--wrap in CMakeLists.txt, only with CLOCK_BENCH)
+void *__real_lv_mem_alloc(size_t size);
+void *__real_lv_mem_realloc(void *data_p, size_t new_size);
+
+void *__wrap_lv_mem_alloc(size_t size)
+{
+    bench_allocs++;
+    return __real_lv_mem_alloc(size);
+}
+
+void *__wrap_lv_mem_realloc(void *data_p, size_t new_size)
+{
+    bench_allocs++;
+    return __real_lv_mem_realloc(data_p, new_size);
+}
+#endif
+
+void bench_ui_busy(int64_t us)
+{
+    bench_busy_us += us;
+}
+
+static void bench_monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    bench_flushed_px += px;
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// Run time of a task in run time stats units, us with the default esp_timer counter
+static uint32_t bench_task_runtime(const char *name)
+{
+    TaskHandle_t task = xTaskGetHandle(name);
+    TaskStatus_t status;
+
+    if (!task)
+        return 0;
+    vTaskGetInfo(task, &status, pdFALSE, eRunning);
+    return status.ulRunTimeCounter;
+}
+#endif
+
+// What the esp_timer task costs, it runs the callbacks of every esp_timer
+static void bench_monitor_esp_timer(void)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    static uint32_t last = 0;
+    uint32_t now = bench_task_runtime("esp_timer");
+
+    ESP_LOGI(TAG, "esp_timer: %u us cpu/s", (now - last) * 1000 / BENCH_MONITOR_PERIOD);
+    last = now;
+#endif
+#if CONFIG_ESP_TIMER_PROFILING
+    // One line per timer, times_triggered is the number of alarm interrupts it took
+    esp_timer_dump(stdout);
+#endif
+}
+
+static void bench_monitor_timer(lv_timer_t *timer)
+{
+    ST77XX_Stats_t stats;
+
+    ST77XX_GetStats(&stats);
+    ST77XX_ResetStats();
+    ESP_LOGI(TAG, "wire: %u bytes/s, %u transactions/s, %u windows/s",
+             stats.bytes * 1000 / BENCH_MONITOR_PERIOD,
+             stats.transactions * 1000 / BENCH_MONITOR_PERIOD,
+             stats.windows * 1000 / BENCH_MONITOR_PERIOD);
+    ESP_LOGI(TAG, "ui: %u us cpu/s, %u px flushed/s, %u lv_mem allocs/s",
+             (uint32_t)(bench_busy_us * 1000 / BENCH_MONITOR_PERIOD),
+             bench_flushed_px * 1000 / BENCH_MONITOR_PERIOD,
+             bench_allocs * 1000 / BENCH_MONITOR_PERIOD);
+    bench_busy_us = 0;
+    bench_flushed_px = 0;
+    bench_allocs = 0;
+    bench_monitor_esp_timer();
+}
+
+void bench_monitor_start(void)
+{
+    ST77XX_ResetStats();
+    lv_disp_get_default()->driver->monitor_cb = bench_monitor_cb;
+    lv_timer_create(bench_monitor_timer, BENCH_MONITOR_PERIOD, NULL);
+}
+
+void bench_run(lv_disp_t *disp)
+{
+    // The flush callbacks of these two send the buffer as a band, not in direct mode
+    bool direct = disp->driver->direct_mode;
+
+    if (!direct)
+        bench_flush_overlap(disp);
+    bench_small_flush(false);
+    bench_small_flush(true);
+    bench_primitives();
+    bench_fill();
+    bench_glyphs();
+    bench_string();
+    bench_clock_digits();
+    bench_clock_text(disp);
+    bench_font_lookup();
+    bench_font_cache(disp);
+    if (!direct)
+        bench_wire_format(disp);
+    bench_disp_buf(disp);
+    lv_obj_invalidate(lv_scr_act());
+}
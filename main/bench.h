@@ -0,0 +1,19 @@
+#pragma once
+
+#include "lvgl.h"
+
+// Set to 1 to run the display benchmarks once at boot, results go to the console. Also
+// read by main/CMakeLists.txt, which only wraps the LVGL allocator for the monitor then.
+#define CLOCK_BENCH 0
+// Set to 1 for the old clock UI, two labels formatted in full every tick, to compare
+// the monitor numbers against
+#define CLOCK_BENCH_LEGACY_UI 0
+
+void bench_run(lv_disp_t *disp);
+// Prints the bus traffic, CPU time and flushed pixels of the running UI every few seconds.
+// With CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS it
+// adds the CPU time of the esp_timer task, with CONFIG_ESP_TIMER_PROFILING the alarms of
+// every esp_timer.
+void bench_monitor_start(void);
+// Time spent in lv_task_handler, for the monitor
+void bench_ui_busy(int64_t us);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+// Characters of the atlas, in cell order
+#define CLOCK_ATLAS_CHARS   "0123456789:."
+#define CLOCK_ATLAS_COUNT   12
+
+typedef struct {
+    uint8_t width;
+    uint32_t offset;        // first pixel of the cell in pixels[]
+} clock_atlas_cell_t;
+
+// Clock characters pre-rendered at build time (tools/gen_digit_atlas.py), one cell of
+// `height` rows of `width` pixels each, RGB565 in lv_color_t byte order with the glyph
+// already blended against `bg`
+typedef struct {
+    uint8_t height;
+    uint32_t fg;            // 0xRRGGBB the cells were rendered with
+    uint32_t bg;
+    clock_atlas_cell_t cells[CLOCK_ATLAS_COUNT];
+    const uint16_t *pixels;
+} clock_atlas_t;
+
+extern const clock_atlas_t clock_atlas;
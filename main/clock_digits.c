@@ -0,0 +1,158 @@
+/* Clock digits widget
+
+   Shows the clock text with cells of clock_atlas, which are already blended
+   against the background, so drawing a character is a row by row copy into
+   the draw buffer: no glyph lookup, no alpha blending, no text layout.
+   Written against the LVGL 8.2 draw path, where LV_EVENT_DRAW_MAIN passes the
+   clip area and the display draw buffer covers draw_buf->area.
+*/
+#include <string.h>
+#include "clock_atlas.h"
+#include "clock_digits.h"
+
+#if LV_COLOR_DEPTH != 16
+#error "clock_atlas is RGB565"
+#endif
+
+typedef struct {
+    lv_obj_t obj;
+    int8_t cell[CLOCK_DIGITS_MAX];          // atlas cell of each character, -1 for none
+    lv_coord_t x[CLOCK_DIGITS_MAX + 1];     // left edge of each character, x[len] is the width
+    uint8_t len;
+} clock_digits_t;
+
+static void clock_digits_constructor(const lv_obj_class_t *class_p, lv_obj_t *obj);
+static void clock_digits_event(const lv_obj_class_t *class_p, lv_event_t *e);
+
+static const lv_obj_class_t clock_digits_class = {
+    .constructor_cb = clock_digits_constructor,
+    .event_cb = clock_digits_event,
+    .width_def = LV_SIZE_CONTENT,
+    .height_def = LV_SIZE_CONTENT,
+    .instance_size = sizeof(clock_digits_t),
+    .base_class = &lv_obj_class,
+};
+
+static int clock_digits_cell(char c)
+{
+    const char *p = c ? strchr(CLOCK_ATLAS_CHARS, c) : NULL;
+
+    return p ? p - CLOCK_ATLAS_CHARS : -1;
+}
+
+static void clock_digits_constructor(const lv_obj_class_t *class_p, lv_obj_t *obj)
+{
+    clock_digits_t *digits = (clock_digits_t *)obj;
+
+    digits->len = 0;
+    digits->x[0] = 0;
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+}
+
+// Copies the visible part of every cell into the buffer LVGL is rendering
+static void clock_digits_draw(clock_digits_t *digits, const lv_area_t *clip)
+{
+    lv_disp_draw_buf_t *draw_buf = lv_disp_get_draw_buf(_lv_refr_get_disp_refreshing());
+    const lv_area_t *buf_area = &draw_buf->area;
+    lv_coord_t stride = lv_area_get_width(buf_area);
+    lv_area_t cell, area;
+    int i;
+
+    cell.y1 = digits->obj.coords.y1;
+    cell.y2 = cell.y1 + clock_atlas.height - 1;
+    for (i = 0; i < digits->len; i++)
+    {
+        if (digits->cell[i] < 0)
+            continue;
+        cell.x1 = digits->obj.coords.x1 + digits->x[i];
+        cell.x2 = digits->obj.coords.x1 + digits->x[i + 1] - 1;
+        if (!_lv_area_intersect(&area, &cell, clip))
+            continue;
+
+        const clock_atlas_cell_t *ac = &clock_atlas.cells[digits->cell[i]];
+        const lv_color_t *src = (const lv_color_t *)clock_atlas.pixels + ac->offset +
+                                (area.y1 - cell.y1) * ac->width + (area.x1 - cell.x1);
+        lv_color_t *dst = (lv_color_t *)draw_buf->buf_act + (area.y1 - buf_area->y1) * stride +
+                          (area.x1 - buf_area->x1);
+        size_t row = lv_area_get_width(&area) * sizeof(lv_color_t);
+        lv_coord_t y;
+
+        for (y = area.y1; y <= area.y2; y++)
+        {
+            memcpy(dst, src, row);
+            dst += stride;
+            src += ac->width;
+        }
+    }
+}
+
+static void clock_digits_event(const lv_obj_class_t *class_p, lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    clock_digits_t *digits = (clock_digits_t *)obj;
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (lv_obj_event_base(&clock_digits_class, e) != LV_RES_OK)
+        return;
+
+    if (code == LV_EVENT_GET_SELF_SIZE)
+    {
+        lv_point_t *p = lv_event_get_param(e);
+        p->x = LV_MAX(p->x, digits->x[digits->len]);
+        p->y = LV_MAX(p->y, clock_atlas.height);
+    }
+    else if (code == LV_EVENT_DRAW_MAIN)
+    {
+        clock_digits_draw(digits, lv_event_get_param(e));
+    }
+}
+
+lv_obj_t *clock_digits_create(lv_obj_t *parent)
+{
+    lv_obj_t *obj = lv_obj_class_create_obj(&clock_digits_class, parent);
+
+    lv_obj_class_init_obj(obj);
+    return obj;
+}
+
+void clock_digits_set_text(lv_obj_t *obj, const char *text)
+{
+    clock_digits_t *digits = (clock_digits_t *)obj;
+    bool moved = false;
+    lv_area_t area;
+    lv_coord_t x = 0;
+    int i, cell;
+
+    for (i = 0; i < CLOCK_DIGITS_MAX && text[i]; i++)
+    {
+        cell = clock_digits_cell(text[i]);
+        if (i >= digits->len || cell != digits->cell[i])
+        {
+            // Digits all have the same width, only a change of layout moves cells
+            if (i >= digits->len || cell < 0 || digits->cell[i] < 0 ||
+                clock_atlas.cells[cell].width != clock_atlas.cells[digits->cell[i]].width)
+                moved = true;
+            if (!moved)
+            {
+                area.x1 = obj->coords.x1 + x;
+                area.x2 = area.x1 + clock_atlas.cells[cell].width - 1;
+                area.y1 = obj->coords.y1;
+                area.y2 = area.y1 + clock_atlas.height - 1;
+                lv_obj_invalidate_area(obj, &area);
+            }
+            digits->cell[i] = cell;
+        }
+        digits->x[i] = x;
+        x += cell < 0 ? 0 : clock_atlas.cells[cell].width;
+    }
+    if (i != digits->len)
+        moved = true;
+    digits->len = i;
+    digits->x[i] = x;
+
+    if (moved)
+    {
+        lv_obj_refresh_self_size(obj);
+        lv_obj_invalidate(obj);
+    }
+}
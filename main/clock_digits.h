@@ -0,0 +1,13 @@
+#pragma once
+
+#include "lvgl.h"
+
+// Longest text a clock_digits widget shows
+#define CLOCK_DIGITS_MAX    16
+
+// Clock text drawn from the pre-rendered clock_atlas instead of a font: every character
+// is a fixed cell copied into the draw buffer, and setting new text only invalidates the
+// cells that changed. The text may only use CLOCK_ATLAS_CHARS, anything else is left out,
+// and the widget must sit on a background of clock_atlas.bg.
+lv_obj_t *clock_digits_create(lv_obj_t *parent);
+void clock_digits_set_text(lv_obj_t *obj, const char *text);
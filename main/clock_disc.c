@@ -0,0 +1,92 @@
+/* Clock discipline
+
+   Each sync measures the rate of the clock over the interval since the one
+   before: the offset it finds plus what was taken out of the clock
+   meanwhile. The measurement is off by two sync errors over the interval, so
+   long intervals measure well. The Kalman filter keeps the variance of the
+   rate, grown by the wander over each interval and shrunk by each
+   measurement. The rate is taken out of the clock continuously by the caller
+   (clock_disc_correction), what is left grows at the uncertainty of the rate,
+   so the better it is known the later the next sync. The interval at most
+   doubles from one sync to the next, the confidence has to be earned.
+
+   Pure C, host/clock_disc_check.c runs it against synthetic clocks.
+*/
+#include <math.h>
+#include <stdlib.h>
+#include "clock_disc.h"
+
+// Variance the wander adds per second, ppb^2
+#define CLOCK_DISC_WANDER_VAR_S     ((double)CLOCK_DISC_WANDER_PPB * CLOCK_DISC_WANDER_PPB / 3600)
+
+static uint32_t clock_disc_plan(const clock_disc_t *d)
+{
+    uint32_t lo = CLOCK_DISC_MIN_INTERVAL_S, hi = CLOCK_DISC_MAX_INTERVAL_S;
+    uint32_t limit = d->interval_s * 2;
+
+    // Longest interval within the error budget, the error grows with time
+    if (clock_disc_error_us(d, (int64_t)lo * 1000000) >= CLOCK_DISC_MAX_ERROR_US)
+        return lo;
+    while (hi - lo > 1)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (clock_disc_error_us(d, (int64_t)mid * 1000000) < CLOCK_DISC_MAX_ERROR_US)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if (lo > limit)
+        lo = limit;
+    return lo < CLOCK_DISC_MIN_INTERVAL_S ? CLOCK_DISC_MIN_INTERVAL_S : lo;
+}
+
+void clock_disc_init(clock_disc_t *d)
+{
+    d->freq_ppb = 0;
+    d->var_ppb2 = (int64_t)CLOCK_DISC_INIT_PPM * 1000 * CLOCK_DISC_INIT_PPM * 1000;
+    d->samples = 0;
+    // Half of it, the first sync can already double it
+    d->interval_s = CLOCK_DISC_MIN_INTERVAL_S / 2;
+    d->interval_s = clock_disc_plan(d);
+}
+
+void clock_disc_update(clock_disc_t *d, int64_t interval_us, int64_t corrected_us, int64_t offset_us)
+{
+    double s = interval_us / 1e6;
+    double meas, p, r, k;
+
+    if (interval_us >= CLOCK_DISC_MIN_INTERVAL_S * 1000000LL && llabs(offset_us) < interval_us / 100)
+    {
+        // The clock ran interval * (1 + rate) - corrected while the true time ran interval
+        meas = (double)(corrected_us - offset_us) * 1e9 / interval_us;
+        p = d->var_ppb2 + CLOCK_DISC_WANDER_VAR_S * s;
+        r = 2.0 * CLOCK_DISC_SYNC_ERROR_US * CLOCK_DISC_SYNC_ERROR_US * 1e6 / (s * s);
+        k = p / (p + r);
+        d->freq_ppb = lround(d->freq_ppb + k * (meas - d->freq_ppb));
+        d->var_ppb2 = llround((1 - k) * p);
+        d->samples++;
+    }
+    d->interval_s = clock_disc_plan(d);
+}
+
+void clock_disc_lost(clock_disc_t *d)
+{
+    d->var_ppb2 += llround(CLOCK_DISC_WANDER_VAR_S * 86400);
+    d->interval_s = CLOCK_DISC_MIN_INTERVAL_S / 2;
+    d->interval_s = clock_disc_plan(d);
+}
+
+int64_t clock_disc_correction(const clock_disc_t *d, int64_t elapsed_us)
+{
+    return elapsed_us * d->freq_ppb / 1000000000LL;
+}
+
+int64_t clock_disc_error_us(const clock_disc_t *d, int64_t elapsed_us)
+{
+    double s = llabs(elapsed_us) / 1e6;
+    double sigma = sqrt(d->var_ppb2 + CLOCK_DISC_WANDER_VAR_S * s);
+
+    // The sync error, plus the rate uncertainty over the elapsed time (ppb * s = 1e-3 us)
+    return CLOCK_DISC_SYNC_ERROR_US * CLOCK_DISC_SIGMAS + llround(CLOCK_DISC_SIGMAS * sigma * s / 1000);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// A sync is due once the estimated error of the clock passes this
+#define CLOCK_DISC_MAX_ERROR_US     500000
+// Error of the offset one sync measures, network delay and its jitter, 1 sigma
+#define CLOCK_DISC_SYNC_ERROR_US    20000
+// Rate error of the clock until it was measured, 1 sigma
+#define CLOCK_DISC_INIT_PPM         100
+// How far the rate wanders with temperature and age, ppb per square root of an hour
+#define CLOCK_DISC_WANDER_PPB       200
+// Sigmas the error estimate covers
+#define CLOCK_DISC_SIGMAS           2
+// Shortest and longest time between two syncs. Over shorter intervals the rate is not
+// measured, the network error would swamp it.
+#define CLOCK_DISC_MIN_INTERVAL_S   600
+#define CLOCK_DISC_MAX_INTERVAL_S   (3 * 86400)
+
+// Rate of the clock learned from the offsets of successive syncs, with a Kalman filter
+// that weighs each measurement against how well the rate is known already
+typedef struct {
+    int32_t freq_ppb;       // rate error, positive when the clock runs fast, taken out of it
+    int64_t var_ppb2;       // variance of freq_ppb right after the last sync
+    uint32_t interval_s;    // planned time from the last sync to the next
+    uint16_t samples;       // rate measurements so far
+} clock_disc_t;
+
+void clock_disc_init(clock_disc_t *d);
+// A sync `interval_us` after the last one found the clock `offset_us` off, true time minus
+// the clock, after `corrected_us` had been taken out of it. Updates the rate and plans the
+// next sync. An offset of more than 1% of the interval is the clock being set by something
+// else and not measured.
+void clock_disc_update(clock_disc_t *d, int64_t interval_us, int64_t corrected_us, int64_t offset_us);
+// The time base was lost, a power loss. The rate is kept, trusted a day of wander less.
+void clock_disc_lost(clock_disc_t *d);
+// What should have been taken out of the clock `elapsed_us` after the last sync
+int64_t clock_disc_correction(const clock_disc_t *d, int64_t elapsed_us);
+// Estimated error of the clock `elapsed_us` after the last sync
+int64_t clock_disc_error_us(const clock_disc_t *d, int64_t elapsed_us);
@@ -0,0 +1,70 @@
+/* Clock text formatting
+
+   Writes the clock strings into caller buffers with digit lookup tables,
+   so the labels can use static text and a tick neither runs vsnprintf nor
+   touches the LVGL heap.
+*/
+#include <string.h>
+#include "clock_fmt.h"
+
+#define D10(t) t "0", t "1", t "2", t "3", t "4", t "5", t "6", t "7", t "8", t "9"
+
+// "00" to "99"
+static const char clock_digits[100][2] = {
+    D10("0"), D10("1"), D10("2"), D10("3"), D10("4"),
+    D10("5"), D10("6"), D10("7"), D10("8"), D10("9"),
+};
+
+static const char clock_week[7][4] = {"天", "一", "二", "三", "四", "五", "六"};
+
+static inline char *clock_fmt_2d(char *dst, int v)
+{
+    dst[0] = clock_digits[v][0];
+    dst[1] = clock_digits[v][1];
+    return dst + 2;
+}
+
+static inline char *clock_fmt_str(char *dst, const char *s)
+{
+    size_t len = strlen(s);
+
+    memcpy(dst, s, len);
+    return dst + len;
+}
+
+// "HH:MM:SS.mmm", "HH:MM:SS" if ms is negative
+char *clock_fmt_time(char *dst, const struct tm *tm, int ms)
+{
+    dst = clock_fmt_2d(dst, tm->tm_hour);
+    *dst++ = ':';
+    dst = clock_fmt_2d(dst, tm->tm_min);
+    *dst++ = ':';
+    dst = clock_fmt_2d(dst, tm->tm_sec);
+    if (ms >= 0)
+    {
+        *dst++ = '.';
+        *dst++ = '0' + ms / 100;
+        dst = clock_fmt_2d(dst, ms % 100);
+    }
+    *dst = '\0';
+    return dst;
+}
+
+// "YYYY年M月DD 星期W"
+char *clock_fmt_date(char *dst, const struct tm *tm)
+{
+    int year = tm->tm_year + 1900, mon = tm->tm_mon + 1;
+
+    dst = clock_fmt_2d(dst, year / 100 % 100);
+    dst = clock_fmt_2d(dst, year % 100);
+    dst = clock_fmt_str(dst, "年");
+    if (mon >= 10)
+        *dst++ = '1';
+    *dst++ = '0' + mon % 10;
+    dst = clock_fmt_str(dst, "月");
+    dst = clock_fmt_2d(dst, tm->tm_mday);
+    dst = clock_fmt_str(dst, " 星期");
+    dst = clock_fmt_str(dst, clock_week[tm->tm_wday]);
+    *dst = '\0';
+    return dst;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <time.h>
+#include "lvgl.h"
+
+// "2022年12月31 星期六" plus the terminator, the CJK characters are 3 bytes in UTF-8
+#define CLOCK_DATE_MAX      32
+
+// Time and date text without printf or the heap, all return the end of what was written
+// and terminate the string there. clock_fmt_time leaves the milliseconds out if ms < 0.
+char *clock_fmt_time(char *dst, const struct tm *tm, int ms);
+char *clock_fmt_date(char *dst, const struct tm *tm);
+
+// The characters of the strings in clock_fmt.c cut out of lv_font_simsun_16_cjk at build
+// time (tools/gen_font_subset.py), enough for any date clock_fmt_date writes
+LV_FONT_DECLARE(clock_font_date_subset)
@@ -0,0 +1,50 @@
+/* Clock model
+
+   Keeps the displayed time and tells which fields changed since the last
+   update, so the UI only touches the characters and labels that need it.
+   The day covers the whole date: year, month, day of month and weekday.
+*/
+#include <string.h>
+#include "clock_fmt.h"
+#include "clock_model.h"
+
+void clock_model_init(clock_model_t *model)
+{
+    memset(model, 0, sizeof(*model));
+    model->first = 1;
+}
+
+uint32_t clock_model_update(clock_model_t *model, const struct timeval *tv)
+{
+    struct tm tm;
+    int ms = CLOCK_SHOW_MILLIS ? tv->tv_usec / 1000 : -1;
+    uint32_t changed = 0;
+
+    localtime_r(&tv->tv_sec, &tm);
+
+    if (model->first)
+    {
+        changed = CLOCK_CHANGED_ALL;
+        model->first = 0;
+    }
+    else
+    {
+        if (ms != model->ms)
+            changed |= CLOCK_CHANGED_MS;
+        if (tm.tm_sec != model->tm.tm_sec)
+            changed |= CLOCK_CHANGED_SEC;
+        if (tm.tm_min != model->tm.tm_min)
+            changed |= CLOCK_CHANGED_MIN;
+        if (tm.tm_hour != model->tm.tm_hour)
+            changed |= CLOCK_CHANGED_HOUR;
+        if (tm.tm_mday != model->tm.tm_mday || tm.tm_mon != model->tm.tm_mon || tm.tm_year != model->tm.tm_year)
+            changed |= CLOCK_CHANGED_DAY;
+    }
+    if (!changed)
+        return 0;
+
+    model->tm = tm;
+    model->ms = ms;
+    clock_fmt_time(model->time_text, &tm, ms);
+    return changed;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+// Bits returned by clock_model_update, one per field of the clock
+#define CLOCK_CHANGED_MS    (1 << 0)
+#define CLOCK_CHANGED_SEC   (1 << 1)
+#define CLOCK_CHANGED_MIN   (1 << 2)
+#define CLOCK_CHANGED_HOUR  (1 << 3)
+#define CLOCK_CHANGED_DAY   (1 << 4)
+#define CLOCK_CHANGED_ALL   0x1F
+
+// 1 shows "HH:MM:SS.mmm" and the clock ticks at the display refresh rate, 0 shows
+// "HH:MM:SS" and the UI only wakes up once a second
+#define CLOCK_SHOW_MILLIS   1
+
+#if CLOCK_SHOW_MILLIS
+#define CLOCK_TIME_LEN      12
+#else
+#define CLOCK_TIME_LEN      8
+#endif
+
+typedef struct {
+    struct tm tm;
+    int ms;
+    char time_text[CLOCK_TIME_LEN + 1];
+    uint8_t first;
+} clock_model_t;
+
+void clock_model_init(clock_model_t *model);
+// Moves the model to `tv` in local time and returns the CLOCK_CHANGED_* bits of the
+// fields that differ from the last update, all of them the first time
+uint32_t clock_model_update(clock_model_t *model, const struct timeval *tv);
@@ -0,0 +1,161 @@
+/* Clock screen
+
+   The time and date of the clock and the timer that keeps them current,
+   shared by the firmware and the host simulator (host/clock_sim.c). The time
+   comes from gettimeofday(), so whatever sets the system clock moves it.
+*/
+#include <time.h>
+#include <sys/time.h>
+#include "lvgl.h"
+#include "bench.h"
+#include "clock_model.h"
+#include "clock_fmt.h"
+#include "clock_atlas.h"
+#include "clock_digits.h"
+#include "font_chain.h"
+#include "font_cache.h"
+#include "clock_ui.h"
+
+static lv_timer_t *clock_timer;
+static lv_obj_t *syncSymbol;
+
+#if CLOCK_BENCH_LEGACY_UI
+static void update_label_timer(lv_timer_t * timer)
+{
+    static char week[7][5] = {"天", "一", "二", "三", "四", "五", "六"};
+
+    lv_obj_t** p = (lv_obj_t**)timer->user_data;
+    lv_obj_t* labelTime = *p;
+    lv_obj_t* labelDate = *(p + 1);
+
+    struct timeval tv;
+    struct tm timeinfo;
+
+    gettimeofday(&tv, NULL);
+    localtime_r(&tv.tv_sec, &timeinfo);
+
+    lv_label_set_text_fmt(
+        labelTime,
+        "%02d:%02d:%02d.%03ld",
+        timeinfo.tm_hour,
+        timeinfo.tm_min,
+        timeinfo.tm_sec,
+        tv.tv_usec / 1000
+    );
+    lv_label_set_text_fmt(
+        labelDate,
+        "%04d年%d月%02d 星期%s",
+        timeinfo.tm_year + 1900,
+        timeinfo.tm_mon + 1,
+        timeinfo.tm_mday,
+        week[timeinfo.tm_wday]
+    );
+}
+#else
+// The time is drawn from the pre-rendered digit atlas, a tick only redraws the
+// characters that changed. The date label is only touched when the day rolls over and its
+// text lives in a static buffer, a tick doesn't use the LVGL heap.
+static clock_model_t clock_model;
+static lv_obj_t* clockDigits;
+static lv_obj_t* labelDate;
+static char dateText[CLOCK_DATE_MAX];
+
+static void update_label_timer(lv_timer_t * timer)
+{
+    struct timeval tv;
+    uint32_t changed;
+
+    gettimeofday(&tv, NULL);
+    changed = clock_model_update(&clock_model, &tv);
+#if !CLOCK_SHOW_MILLIS
+    // Next tick right after the next second starts
+    lv_timer_set_period(timer, 1000 - tv.tv_usec / 1000);
+#endif
+    if (!changed)
+        return;
+
+    clock_digits_set_text(clockDigits, clock_model.time_text);
+
+    if (changed & CLOCK_CHANGED_DAY)
+    {
+        clock_fmt_date(dateText, &clock_model.tm);
+        lv_label_set_text_static(labelDate, dateText);
+    }
+}
+#endif
+
+void clock_ui_create(lv_obj_t *scr)
+{
+    // The date font only has the characters clock_fmt_date writes, anything else
+    // falls back to montserrat. Its glyphs are cached, a new day looks up the same few.
+    static font_cache_t dateCache;
+    static font_chain_t dateFont;
+    const lv_font_t *dateFonts[] = {font_cache_init(&dateCache, &clock_font_date_subset), &lv_font_montserrat_16};
+    static lv_style_t styleDate;
+    lv_style_init(&styleDate);
+    lv_style_set_text_color(&styleDate, lv_color_make(0, 0xa0, 0));
+    lv_style_set_text_font(&styleDate,
+                           font_chain_init(&dateFont, dateFonts, sizeof(dateFonts) / sizeof(dateFonts[0])));
+
+#if CLOCK_BENCH_LEGACY_UI
+    static lv_style_t styleTime;
+    lv_style_init(&styleTime);
+    lv_style_set_text_color(&styleTime, lv_color_make(0, 0xa0, 0));
+    lv_style_set_text_font(&styleTime, &lv_font_montserrat_22);
+
+    lv_obj_t* labelTime = lv_label_create(scr);
+    lv_label_set_text(labelTime, "");
+    lv_obj_center(labelTime);
+    lv_obj_align(labelTime, LV_ALIGN_LEFT_MID, 5, -10);
+    lv_obj_add_style(labelTime, &styleTime, 0);
+
+    lv_obj_t* labelDate = lv_label_create(scr);
+    lv_label_set_text(labelDate, "");
+    lv_obj_align_to(labelDate, labelTime, LV_ALIGN_BOTTOM_LEFT, 0, 15);
+    lv_obj_add_style(labelDate, &styleDate, 0);
+
+    static lv_obj_t* labels[2];
+    labels[0] = labelTime;
+    labels[1] = labelDate;
+    clock_timer = lv_timer_create(update_label_timer, 1, labels);
+#else
+    // The atlas cells are blended against this color
+    lv_obj_set_style_bg_color(scr, lv_color_hex(clock_atlas.bg), 0);
+    clockDigits = clock_digits_create(scr);
+    lv_obj_align(clockDigits, LV_ALIGN_LEFT_MID, 5, -10);
+
+    labelDate = lv_label_create(scr);
+    lv_label_set_text_static(labelDate, dateText);
+    lv_obj_align_to(labelDate, clockDigits, LV_ALIGN_BOTTOM_LEFT, 0, 15);
+    lv_obj_add_style(labelDate, &styleDate, 0);
+
+    clock_model_init(&clock_model);
+    // With milliseconds the clock changes every frame, there is no point ticking faster
+    clock_timer = lv_timer_create(update_label_timer, CLOCK_SHOW_MILLIS ? LV_DISP_DEF_REFR_PERIOD : 1000, NULL);
+#endif
+    lv_timer_ready(clock_timer);
+
+    syncSymbol = lv_label_create(scr);
+    lv_label_set_text_static(syncSymbol, "");
+    lv_obj_align(syncSymbol, LV_ALIGN_TOP_RIGHT, -4, 4);
+    lv_obj_set_style_text_color(syncSymbol, lv_color_make(0, 0xa0, 0), 0);
+    lv_obj_set_style_text_font(syncSymbol, &lv_font_montserrat_16, 0);
+    lv_obj_add_flag(syncSymbol, LV_OBJ_FLAG_HIDDEN);
+}
+
+// The clock may have jumped, show it now and line the ticks up with the new seconds
+void clock_ui_time_changed(void)
+{
+    lv_timer_ready(clock_timer);
+}
+
+void clock_ui_set_sync_symbol(const char *symbol)
+{
+    if (symbol)
+    {
+        lv_label_set_text_static(syncSymbol, symbol);
+        lv_obj_clear_flag(syncSymbol, LV_OBJ_FLAG_HIDDEN);
+    }
+    else
+        lv_obj_add_flag(syncSymbol, LV_OBJ_FLAG_HIDDEN);
+}
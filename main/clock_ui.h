@@ -0,0 +1,10 @@
+#pragma once
+
+#include "lvgl.h"
+
+// Builds the clock on `scr` and starts ticking it
+void clock_ui_create(lv_obj_t *scr);
+// To call after the system clock was set, the clock is redrawn right away
+void clock_ui_time_changed(void);
+// Symbol in the top right corner telling how good the time is, NULL for none (the default)
+void clock_ui_set_sync_symbol(const char *symbol);
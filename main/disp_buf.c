@@ -0,0 +1,85 @@
+/* Draw buffer strategies
+
+   How LVGL renders: into bands flushed one after the other, into full
+   frames, or straight into a frame buffer that mirrors the panel.
+*/
+#include "esp_attr.h"
+#include "disp_buf.h"
+
+static const char *disp_buf_names[DISP_BUF_STRATEGIES] = {
+    "single band", "double band", "full frame double", "direct"
+};
+
+void disp_buf_setup(lv_disp_drv_t *drv, lv_disp_draw_buf_t *draw_buf, int strategy, lv_color_t *buf1, lv_color_t *buf2)
+{
+    lv_disp_draw_buf_init(draw_buf, buf1, DISP_BUF_COUNT(strategy) == 2 ? buf2 : NULL, DISP_BUF_PX(strategy));
+    drv->draw_buf = draw_buf;
+    drv->full_refresh = strategy == DISP_BUF_FULL_DOUBLE;
+    drv->direct_mode = strategy == DISP_BUF_DIRECT;
+}
+
+const char *disp_buf_name(int strategy)
+{
+    return disp_buf_names[strategy];
+}
+
+static void IRAM_ATTR disp_buf_flush_done(void *arg)
+{
+    lv_disp_flush_ready((lv_disp_drv_t *)arg);
+}
+
+// Direct mode: the buffer is the whole frame and stays LVGL's, so it is only read. Once the
+// last area is rendered the areas LVGL invalidated in this refresh are sent from it.
+static void disp_buf_flush_direct(lv_disp_drv_t *disp_drv, lv_color_t *frame)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    int i, last = -1;
+
+    if (!lv_disp_flush_is_last(disp_drv))
+    {
+        lv_disp_flush_ready(disp_drv);
+        return;
+    }
+
+    for (i = 0; i < disp->inv_p; i++)
+    {
+        if (!disp->inv_area_joined[i])
+            last = i;
+    }
+    for (i = 0; i <= last; i++)
+    {
+        const lv_area_t *a = &disp->inv_areas[i];
+
+        if (disp->inv_area_joined[i])
+            continue;
+#if ST77XX_SHADOW_GRAM
+        ST77XX_DrawFrameDiff(a->x1, a->y1, lv_area_get_width(a), lv_area_get_height(a), (uint16_t *)frame,
+                             i == last ? disp_buf_flush_done : NULL, disp_drv);
+#else
+        ST77XX_DrawFrame(a->x1, a->y1, lv_area_get_width(a), lv_area_get_height(a), (uint16_t *)frame);
+#endif
+    }
+#if ST77XX_SHADOW_GRAM
+    if (last < 0)
+#endif
+        lv_disp_flush_ready(disp_drv);
+}
+
+// The band is queued for DMA and LVGL is released from the SPI completion interrupt,
+// so the next band is rendered into the other buffer while this one is on the wire.
+// With the shadow GRAM only the pixels that differ from the panel are sent.
+void disp_buf_flush_cb(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    if (disp_drv->direct_mode)
+    {
+        disp_buf_flush_direct(disp_drv, color_p);
+        return;
+    }
+#if ST77XX_SHADOW_GRAM
+    ST77XX_DrawImageDiff(area->x1, area->y1, area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, (uint16_t *)color_p,
+                         disp_buf_flush_done, disp_drv);
+#else
+    ST77XX_DrawImageAsync(area->x1, area->y1, area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, (uint16_t *)color_p,
+                          disp_buf_flush_done, disp_drv);
+#endif
+}
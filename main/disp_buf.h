@@ -0,0 +1,27 @@
+#pragma once
+
+#include "lvgl.h"
+#include "st77xx.h"
+
+// Draw buffer strategies
+#define DISP_BUF_SINGLE         0   // one band of DISP_BUF_LINES rows, rendering waits for the wire
+#define DISP_BUF_DOUBLE         1   // two bands, one is rendered while the other is sent
+#define DISP_BUF_FULL_DOUBLE    2   // two full frames, every refresh renders the whole screen
+#define DISP_BUF_DIRECT         3   // one full frame LVGL draws in place, only dirty areas are sent
+#define DISP_BUF_STRATEGIES     4
+
+// Strategy of the firmware, and band height of the band strategies
+#define DISP_BUF                DISP_BUF_DOUBLE
+#define DISP_BUF_LINES          24
+
+// Pixels per buffer and number of buffers of a strategy, constant expressions
+#define DISP_BUF_PX(s)          ((s) <= DISP_BUF_DOUBLE ? ST77XX_WIDTH * DISP_BUF_LINES : ST77XX_WIDTH * ST77XX_HEIGHT)
+#define DISP_BUF_COUNT(s)       (((s) == DISP_BUF_DOUBLE || (s) == DISP_BUF_FULL_DOUBLE) ? 2 : 1)
+
+// Points `drv` at `draw_buf` set up for `strategy`, with buffers of DISP_BUF_PX pixels,
+// `buf2` is only used by the double buffered strategies. The flush callback has to
+// handle drv->direct_mode, like disp_buf_flush_cb.
+void disp_buf_setup(lv_disp_drv_t *drv, lv_disp_draw_buf_t *draw_buf, int strategy, lv_color_t *buf1, lv_color_t *buf2);
+const char *disp_buf_name(int strategy);
+// Flush callback sending to the ST77XX panel of any of the strategies
+void disp_buf_flush_cb(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p);
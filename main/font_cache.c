@@ -0,0 +1,104 @@
+/* Glyph cache
+
+   A small set associative cache in front of a font. LVGL asks for the
+   descriptor of every letter it lays out or draws and for the bitmap of every
+   letter it draws; with a sparse CJK font each of those is a binary search of
+   the cmap, and with a compressed font every bitmap is decompressed again.
+   LVGL always takes the descriptor before the bitmap of the same letter, so
+   the bitmap is cached in the entry the descriptor lookup filled.
+*/
+#include <string.h>
+#include "font_cache.h"
+
+static uint32_t font_cache_set(uint32_t letter)
+{
+    // Fibonacci hashing, consecutive code points spread over the sets
+    return ((letter * 2654435761u) >> 16) & (FONT_CACHE_SETS - 1);
+}
+
+static font_cache_entry_t *font_cache_find(font_cache_t *cache, uint32_t letter)
+{
+    uint32_t set = font_cache_set(letter);
+
+    for (int way = 0; way < FONT_CACHE_WAYS; way++)
+    {
+        if (cache->entries[set][way].letter == letter)
+        {
+            cache->last[set] = way;
+            return &cache->entries[set][way];
+        }
+    }
+    return NULL;
+}
+
+static bool font_cache_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter,
+                                 uint32_t letter_next)
+{
+    font_cache_t *cache = (font_cache_t *)font->dsc;
+    font_cache_entry_t *entry = letter ? font_cache_find(cache, letter) : NULL;
+    uint32_t set;
+
+    if (entry)
+    {
+        cache->hits++;
+        *dsc = entry->dsc;
+        return true;
+    }
+    cache->misses++;
+    if (!cache->source->get_glyph_dsc(cache->source, dsc, letter, letter_next))
+        return false;
+    if (!letter)
+        return true;
+
+    // Replace the way that wasn't used last
+    set = font_cache_set(letter);
+    cache->last[set] = (cache->last[set] + 1) % FONT_CACHE_WAYS;
+    entry = &cache->entries[set][cache->last[set]];
+    entry->letter = letter;
+    entry->dsc = *dsc;
+    entry->has_bitmap = false;
+    return true;
+}
+
+static const uint8_t *font_cache_glyph_bitmap(const lv_font_t *font, uint32_t letter)
+{
+    font_cache_t *cache = (font_cache_t *)font->dsc;
+    font_cache_entry_t *entry = letter ? font_cache_find(cache, letter) : NULL;
+    const uint8_t *bitmap;
+    uint32_t size;
+
+    if (entry && entry->has_bitmap)
+    {
+        cache->bitmap_hits++;
+        return entry->bitmap;
+    }
+
+    cache->bitmap_misses++;
+    bitmap = cache->source->get_glyph_bitmap(cache->source, letter);
+    if (!entry || !bitmap)
+        return bitmap;
+    size = (entry->dsc.box_w * entry->dsc.box_h * entry->dsc.bpp + 7) / 8;
+    if (size > FONT_CACHE_BITMAP)
+        return bitmap;
+    memcpy(entry->bitmap, bitmap, size);
+    entry->has_bitmap = true;
+    return entry->bitmap;
+}
+
+const lv_font_t *font_cache_init(font_cache_t *cache, const lv_font_t *source)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->source = source;
+    cache->font = *source;
+    cache->font.get_glyph_dsc = font_cache_glyph_dsc;
+    cache->font.get_glyph_bitmap = font_cache_glyph_bitmap;
+    cache->font.dsc = cache;
+    return &cache->font;
+}
+
+void font_cache_reset(font_cache_t *cache)
+{
+    memset(cache->entries, 0, sizeof(cache->entries));
+    memset(cache->last, 0, sizeof(cache->last));
+    cache->hits = cache->misses = cache->bitmap_hits = cache->bitmap_misses = 0;
+}
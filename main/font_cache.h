@@ -0,0 +1,37 @@
+#pragma once
+
+#include "lvgl.h"
+
+// Sets of the cache, a power of two, each of FONT_CACHE_WAYS glyphs
+#define FONT_CACHE_SETS     16
+#define FONT_CACHE_WAYS     2
+// Largest bitmap kept, bigger glyphs are fetched from the font every time.
+// 16x16 at 4 bpp covers simsun_16_cjk.
+#define FONT_CACHE_BITMAP   128
+
+typedef struct {
+    uint32_t letter;                // 0 for an empty entry
+    lv_font_glyph_dsc_t dsc;
+    bool has_bitmap;
+    uint8_t bitmap[FONT_CACHE_BITMAP];
+} font_cache_entry_t;
+
+// A font that keeps the descriptors and bitmaps of the glyphs last drawn with another
+// font, so redrawing the same text skips the cmap search and the bitmap fetch. The bitmaps
+// are copies, a compressed font is only decompressed on a miss. Glyphs are looked up by
+// letter alone, the font must not use kerning (the CJK fonts don't).
+typedef struct {
+    lv_font_t font;
+    const lv_font_t *source;
+    uint32_t hits;                  // descriptor lookups
+    uint32_t misses;
+    uint32_t bitmap_hits;
+    uint32_t bitmap_misses;
+    uint8_t last[FONT_CACHE_SETS];  // way used last in each set
+    font_cache_entry_t entries[FONT_CACHE_SETS][FONT_CACHE_WAYS];
+} font_cache_t;
+
+// Returns &cache->font, to be used instead of `source`
+const lv_font_t *font_cache_init(font_cache_t *cache, const lv_font_t *source);
+// Empties the cache and zeroes the counters
+void font_cache_reset(font_cache_t *cache);
@@ -0,0 +1,64 @@
+/* Font fallback chain
+
+   The chain is an lv_font_t of its own whose callbacks ask each font in turn,
+   so it works with any LVGL 8 version and any font format, without the font
+   fallback field. A lookup the first font answers costs one extra call.
+*/
+#include <string.h>
+#include "font_chain.h"
+
+static bool font_chain_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter,
+                                 uint32_t letter_next)
+{
+    const font_chain_t *chain = font->dsc;
+
+    for (int i = 0; i < chain->count; i++)
+    {
+        const lv_font_t *f = chain->fonts[i];
+
+        if (f->get_glyph_dsc(f, dsc, letter, letter_next))
+            return true;
+    }
+    return false;
+}
+
+// A font without the letter returns NULL, so this lands on the font the descriptor came from
+static const uint8_t *font_chain_glyph_bitmap(const lv_font_t *font, uint32_t letter)
+{
+    const font_chain_t *chain = font->dsc;
+
+    for (int i = 0; i < chain->count; i++)
+    {
+        const lv_font_t *f = chain->fonts[i];
+        const uint8_t *bitmap = f->get_glyph_bitmap(f, letter);
+
+        if (bitmap)
+            return bitmap;
+    }
+    return NULL;
+}
+
+const lv_font_t *font_chain_init(font_chain_t *chain, const lv_font_t *const *fonts, uint8_t count)
+{
+    lv_coord_t above = 0, below = 0;
+
+    LV_ASSERT(count > 0 && count <= FONT_CHAIN_MAX);
+    memset(chain, 0, sizeof(*chain));
+    for (int i = 0; i < count; i++)
+    {
+        chain->fonts[i] = fonts[i];
+        above = LV_MAX(above, fonts[i]->line_height - fonts[i]->base_line);
+        below = LV_MAX(below, fonts[i]->base_line);
+    }
+    chain->count = count;
+
+    chain->font.get_glyph_dsc = font_chain_glyph_dsc;
+    chain->font.get_glyph_bitmap = font_chain_glyph_bitmap;
+    chain->font.line_height = above + below;
+    chain->font.base_line = below;
+    chain->font.subpx = fonts[0]->subpx;
+    chain->font.underline_position = fonts[0]->underline_position;
+    chain->font.underline_thickness = fonts[0]->underline_thickness;
+    chain->font.dsc = chain;
+    return &chain->font;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "lvgl.h"
+
+// Most fonts a chain looks through
+#define FONT_CHAIN_MAX      4
+
+// A font that draws every character with the first of its fonts that has it, so a
+// subset cut down to the known UI text can fall back to a complete font for text that
+// only shows up at run time. The line is tall enough for all of them.
+typedef struct {
+    lv_font_t font;
+    const lv_font_t *fonts[FONT_CHAIN_MAX];
+    uint8_t count;
+} font_chain_t;
+
+// Returns &chain->font, to be used like any other font
+const lv_font_t *font_chain_init(font_chain_t *chain, const lv_font_t *const *fonts, uint8_t count);
@@ -0,0 +1,229 @@
+/* Frame profiler
+
+   Hooks the refresh timer, the flush callback and wait_cb of the display so
+   every refresh LVGL does is timed without touching the drawing code, and
+   keeps the last FRAME_PROF_FRAMES of them in a ring. Nothing is drawn on
+   screen, the numbers only go out over the console when asked for.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+#include "esp_timer.h"
+#include "frame_prof.h"
+
+typedef struct {
+    uint32_t time_ms;       // when the refresh started, since boot
+    uint32_t render_us;     // refresh time minus flush and wait
+    uint32_t flush_us;      // time in the flush callback
+    uint32_t wait_us;       // time waiting for a flush to complete
+    uint32_t areas;         // invalidated areas, before LVGL joins them
+    uint32_t px;            // pixels flushed
+} frame_prof_frame_t;
+
+#define FRAME_PROF_FIELDS (sizeof(frame_prof_frame_t) / sizeof(uint32_t))
+#define FRAME_PROF_FIELD(name) (offsetof(frame_prof_frame_t, name) / sizeof(uint32_t))
+
+static const char *frame_prof_names[FRAME_PROF_FIELDS] = {
+    "time_ms", "render_us", "flush_us", "wait_us", "areas", "px"
+};
+
+static frame_prof_frame_t frame_prof_ring[FRAME_PROF_FRAMES];
+static uint32_t frame_prof_count = 0;
+static portMUX_TYPE frame_prof_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// The frame being refreshed
+static frame_prof_frame_t frame_prof_cur;
+
+static void (*frame_prof_flush)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+static void (*frame_prof_wait)(lv_disp_drv_t *);
+
+static void frame_prof_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    int64_t start = esp_timer_get_time();
+
+    frame_prof_flush(drv, area, color_p);
+    frame_prof_cur.flush_us += esp_timer_get_time() - start;
+    frame_prof_cur.px += lv_area_get_size(area);
+}
+
+// LVGL calls this over and over while a flush is on the wire, wait here until it is done
+static void frame_prof_wait_cb(lv_disp_drv_t *drv)
+{
+    int64_t start = esp_timer_get_time();
+
+    while (drv->draw_buf->flushing)
+    {
+        if (frame_prof_wait)
+            frame_prof_wait(drv);
+    }
+    frame_prof_cur.wait_us += esp_timer_get_time() - start;
+}
+
+static void frame_prof_refr_timer(lv_timer_t *timer)
+{
+    lv_disp_t *disp = timer->user_data;
+    int64_t start;
+    uint32_t total;
+
+    if (disp->inv_p == 0)
+    {
+        _lv_disp_refr_timer(timer);
+        return;
+    }
+
+    memset(&frame_prof_cur, 0, sizeof(frame_prof_cur));
+    frame_prof_cur.areas = disp->inv_p;
+    start = esp_timer_get_time();
+    _lv_disp_refr_timer(timer);
+    total = esp_timer_get_time() - start;
+
+    frame_prof_cur.time_ms = start / 1000;
+    frame_prof_cur.render_us = total - frame_prof_cur.flush_us - frame_prof_cur.wait_us;
+    portENTER_CRITICAL(&frame_prof_lock);
+    frame_prof_ring[frame_prof_count++ % FRAME_PROF_FRAMES] = frame_prof_cur;
+    portEXIT_CRITICAL(&frame_prof_lock);
+}
+
+static int frame_prof_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// Copies the ring, returns the number of frames recorded and sets `first` to the oldest kept.
+// Only the count is read under the lock, a refresh can go on while the entries are copied:
+// the ones it wrote again meanwhile are dropped, and all of them after a reset.
+static uint32_t frame_prof_copy(frame_prof_frame_t *frames, uint32_t *first)
+{
+    uint32_t count, now, i;
+
+    portENTER_CRITICAL(&frame_prof_lock);
+    count = frame_prof_count;
+    portEXIT_CRITICAL(&frame_prof_lock);
+
+    *first = count < FRAME_PROF_FRAMES ? 0 : count - FRAME_PROF_FRAMES;
+    for (i = *first; i < count; i++)
+        frames[i % FRAME_PROF_FRAMES] = frame_prof_ring[i % FRAME_PROF_FRAMES];
+
+    portENTER_CRITICAL(&frame_prof_lock);
+    now = frame_prof_count;
+    portEXIT_CRITICAL(&frame_prof_lock);
+
+    // Frame i shares its slot with frame i + FRAME_PROF_FRAMES
+    if (now < count || now - count >= FRAME_PROF_FRAMES)
+        *first = count;
+    else if (now >= FRAME_PROF_FRAMES && now - FRAME_PROF_FRAMES > *first)
+        *first = now - FRAME_PROF_FRAMES;
+    return count;
+}
+
+// p50, p99 and max of field `f` over the frames from `first` to `count`, sorted in `column`
+static void frame_prof_percentiles(const frame_prof_frame_t *frames, uint32_t first, uint32_t count, uint32_t f,
+                                   uint32_t *column, uint32_t out[3])
+{
+    uint32_t n = count - first, i;
+
+    for (i = 0; i < n; i++)
+        column[i] = ((const uint32_t *)&frames[(first + i) % FRAME_PROF_FRAMES])[f];
+    qsort(column, n, sizeof(column[0]), frame_prof_cmp);
+    out[0] = column[n * 50 / 100];
+    out[1] = column[n * 99 / 100];
+    out[2] = column[n - 1];
+}
+
+void frame_prof_dump(void)
+{
+    // Static, only the console task dumps
+    static frame_prof_frame_t frames[FRAME_PROF_FRAMES];
+    static uint32_t column[FRAME_PROF_FRAMES];
+    uint32_t count, first, i, f;
+
+    count = frame_prof_copy(frames, &first);
+
+    printf("frame");
+    for (f = 0; f < FRAME_PROF_FIELDS; f++)
+        printf(",%s", frame_prof_names[f]);
+    printf("\n");
+    for (i = first; i < count; i++)
+    {
+        const uint32_t *v = (const uint32_t *)&frames[i % FRAME_PROF_FRAMES];
+        printf("%u", i);
+        for (f = 0; f < FRAME_PROF_FIELDS; f++)
+            printf(",%u", v[f]);
+        printf("\n");
+    }
+    if (count == first)
+        return;
+
+    // One row per statistic, a column per field, time_ms left empty
+    static const char *stats[] = {"p50", "p99", "max"};
+    uint32_t rows[FRAME_PROF_FIELDS][3];
+    for (f = 1; f < FRAME_PROF_FIELDS; f++)
+        frame_prof_percentiles(frames, first, count, f, column, rows[f]);
+    for (i = 0; i < 3; i++)
+    {
+        printf("%s,", stats[i]);
+        for (f = 1; f < FRAME_PROF_FIELDS; f++)
+            printf(",%u", rows[f][i]);
+        printf("\n");
+    }
+}
+
+void frame_prof_stats(frame_prof_stats_t *stats)
+{
+    // Static, apart from the ones of frame_prof_dump so both can run at the same time
+    static frame_prof_frame_t frames[FRAME_PROF_FRAMES];
+    static uint32_t column[FRAME_PROF_FRAMES];
+    uint32_t first;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->frames = frame_prof_copy(frames, &first);
+    if (stats->frames == first)
+        return;
+    frame_prof_percentiles(frames, first, stats->frames, FRAME_PROF_FIELD(render_us), column, stats->render_us);
+    frame_prof_percentiles(frames, first, stats->frames, FRAME_PROF_FIELD(flush_us), column, stats->flush_us);
+    frame_prof_percentiles(frames, first, stats->frames, FRAME_PROF_FIELD(wait_us), column, stats->wait_us);
+    frame_prof_percentiles(frames, first, stats->frames, FRAME_PROF_FIELD(px), column, stats->px);
+}
+
+void frame_prof_reset(void)
+{
+    portENTER_CRITICAL(&frame_prof_lock);
+    frame_prof_count = 0;
+    portEXIT_CRITICAL(&frame_prof_lock);
+}
+
+// Reads single character commands from the console UART
+static void frame_prof_console(void *arg)
+{
+    uint8_t c;
+
+    while (1)
+    {
+        if (uart_read_bytes(CONFIG_ESP_CONSOLE_UART_NUM, &c, 1, portMAX_DELAY) != 1)
+            continue;
+        if (c == 'p')
+            frame_prof_dump();
+        else if (c == 'r')
+            frame_prof_reset();
+    }
+}
+
+void frame_prof_start(lv_disp_t *disp)
+{
+    frame_prof_flush = disp->driver->flush_cb;
+    frame_prof_wait = disp->driver->wait_cb;
+    disp->driver->flush_cb = frame_prof_flush_cb;
+    disp->driver->wait_cb = frame_prof_wait_cb;
+    disp->refr_timer->timer_cb = frame_prof_refr_timer;
+
+#if FRAME_PROF
+    ESP_ERROR_CHECK(uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0));
+    xTaskCreate(frame_prof_console, "frame_prof", 3072, NULL, tskIDLE_PRIORITY + 1, NULL);
+#endif
+}
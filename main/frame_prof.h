@@ -0,0 +1,31 @@
+#pragma once
+
+#include "lvgl.h"
+
+// Set to 0 to leave the frame profiler out
+#define FRAME_PROF 1
+// Frames kept for the CSV dump and the percentiles
+#define FRAME_PROF_FRAMES 256
+
+// Records every refresh of `disp`: render time, time in the flush callback, time LVGL
+// waited for the SPI transfer, invalidated areas and flushed pixels. Send 'p' on the
+// console to get the recorded frames and their p50/p99/max as CSV, 'r' to start over.
+// With FRAME_PROF set this installs the UART driver on the console UART and reads it
+// from a task of its own, nothing else can read console input then. Without it only
+// frame_prof_stats() gives numbers. Call after the display driver is complete.
+void frame_prof_start(lv_disp_t *disp);
+
+// Statistics of the frames recorded since the last reset, index 0 is p50, 1 p99, 2 max.
+// The percentiles cover the last FRAME_PROF_FRAMES of them.
+typedef struct {
+    uint32_t frames;
+    uint32_t render_us[3];
+    uint32_t flush_us[3];
+    uint32_t wait_us[3];
+    uint32_t px[3];
+} frame_prof_stats_t;
+
+// Prints the CSV, from one task at a time, frame_prof_stats() may run alongside it
+void frame_prof_dump(void);
+void frame_prof_stats(frame_prof_stats_t *stats);
+void frame_prof_reset(void);
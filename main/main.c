@@ -15,31 +15,43 @@
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
 #include "lvgl.h"
-#include "demos/lv_demos.h"
-#include "examples/lv_examples.h"
 #include "st7735.h"
+#include "st77xx_bus_esp.h"
 #include "input.h"
 #include "my_sntp.h"
-
-#define LV_TICK_PERIOD_MS 1
+#include "bench.h"
+#include "frame_prof.h"
+#include "clock_ui.h"
+#include "ui_loop.h"
+#include "disp_buf.h"
+#include "panel_init.h"
 
 #define SCREEN_W ST77XX_WIDTH
 #define SCREEN_H ST77XX_HEIGHT
 
-#define BUF_LINES 24
-
 static lv_disp_draw_buf_t disp_buf;
 
-static lv_color_t buf_1[SCREEN_W * BUF_LINES];
-static lv_color_t buf_2[SCREEN_W * BUF_LINES];
+static lv_color_t buf_1[DISP_BUF_PX(DISP_BUF)];
+#if DISP_BUF_COUNT(DISP_BUF) == 2
+static lv_color_t buf_2[DISP_BUF_PX(DISP_BUF)];
+#else
+#define buf_2 NULL
+#endif
 
 static lv_disp_drv_t disp_drv;
 
-static lv_key_t lastKey = 0;
-static bool lastKeyPress = false;
+static volatile lv_key_t lastKey = 0;
+static volatile bool lastKeyPress = false;
+// Set by a press until keyboard_read reports it, a key released before the UI task gets to
+// read it still goes to LVGL as pressed once
+static volatile bool pendingKeyPress = false;
+
+static lv_indev_t *keypad;
 
 static void input_callback(Key key, bool press)
 {
@@ -69,27 +81,79 @@ static void input_callback(Key key, bool press)
             lastKey = LV_KEY_ENTER;
             break;
         }
+        pendingKeyPress = true;
     }
+    ui_loop_post(UI_LOOP_EVENT_INPUT);
 }
 
-void my_flush_cb(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p)
+// The keypad is only polled while a key is down, input_callback wakes it up
+static void keyboard_read(lv_indev_drv_t * drv, lv_indev_data_t*data)
 {
-    ST77XX_DrawImage(area->x1, area->y1, area->x2 - area->x1 + 1, area->y2 - area->y1 + 1, (uint16_t *)color_p);
+  bool press = pendingKeyPress;
 
-    lv_disp_flush_ready(disp_drv);
+  pendingKeyPress = false;
+  press = press || lastKeyPress;
+  data->key = lastKey;
+  data->state = press ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+  if (!press)
+    lv_timer_pause(drv->read_timer);
 }
 
-static void lv_tick_task(void *arg)
+static void panel_ready(void)
 {
-    (void)arg;
+    ui_loop_post(UI_LOOP_EVENT_PANEL);
+}
 
-    lv_tick_inc(LV_TICK_PERIOD_MS);
+// Frames rendered before the panel is on are dropped, the screen is drawn again once it is
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    if (!panel_init_ready())
+    {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+    disp_buf_flush_cb(drv, area, color_p);
 }
 
-static void keyboard_read(lv_indev_drv_t * drv, lv_indev_data_t*data)
+// First frame on the panel, time to first pixel is from reset to the end of its transfer
+static void first_frame(void)
 {
-  data->key = lastKey;
-  data->state = lastKeyPress ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+    lv_disp_t *disp = lv_disp_get_default();
+
+    lv_obj_invalidate(lv_scr_act());
+    lv_refr_now(disp);
+    ST77XX_WaitAsync();
+    printf("first frame %u ms after boot\n", (unsigned)(esp_timer_get_time() / 1000));
+}
+
+// The clock shows from the start, a symbol tells while its time is provisional. A resync
+// shows the radio symbols too, the time stays good meanwhile.
+static void sync_changed(void)
+{
+    static const char *const symbols[] = {
+        [MY_SNTP_UNSYNCED] = LV_SYMBOL_WARNING,
+        [MY_SNTP_CONNECTING] = LV_SYMBOL_WIFI,
+        [MY_SNTP_SYNCING] = LV_SYMBOL_REFRESH,
+        [MY_SNTP_SYNCED] = NULL,
+        [MY_SNTP_RESYNC_DUE] = NULL,
+    };
+
+    clock_ui_set_sync_symbol(symbols[my_sntp_state()]);
+}
+
+static void ui_event_cb(uint32_t events)
+{
+    if (events & UI_LOOP_EVENT_PANEL)
+        first_frame();
+    if (events & UI_LOOP_EVENT_INPUT)
+    {
+        lv_timer_resume(keypad->driver->read_timer);
+        lv_timer_ready(keypad->driver->read_timer);
+    }
+    if (events & UI_LOOP_EVENT_TIME)
+        clock_ui_time_changed();
+    if (events & UI_LOOP_EVENT_SYNC)
+        sync_changed();
 }
 
 static void init()
@@ -98,23 +162,31 @@ static void init()
 
     input_init(&input_callback);
 
-    ST7735_Init();
-    printf("ST7735 Inited\n");
+    // The panel's init delays run while the rest of the boot goes on, UI_LOOP_EVENT_PANEL
+    // when it is done
+    panel_init_start(&st77xx_bus_esp, panel_ready);
 
-    lv_disp_draw_buf_init(&disp_buf, buf_1, buf_2, SCREEN_W * BUF_LINES);
     lv_disp_drv_init(&disp_drv);
-    disp_drv.draw_buf = &disp_buf;
-    disp_drv.flush_cb = my_flush_cb;
+    disp_buf_setup(&disp_drv, &disp_buf, DISP_BUF, buf_1, buf_2);
+    disp_drv.flush_cb = flush_cb;
     disp_drv.hor_res = SCREEN_W;
     disp_drv.ver_res = SCREEN_H;
     lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+#if CLOCK_BENCH
+    panel_init_wait();
+    bench_run(disp);
+#endif
+#if FRAME_PROF
+    frame_prof_start(disp);
+#endif
 
     static lv_indev_drv_t indev_drv;
     lv_indev_drv_init(&indev_drv);
     indev_drv.type = LV_INDEV_TYPE_KEYPAD;
     indev_drv.read_cb = keyboard_read;
     /*Register the driver in LVGL and save the created input device object*/
-    lv_indev_t * my_indev = lv_indev_drv_register(&indev_drv);
+    keypad = lv_indev_drv_register(&indev_drv);
+    lv_timer_pause(indev_drv.read_timer);
 
     lv_group_t* group = lv_group_get_default();
     if (!group)
@@ -126,46 +198,10 @@ static void init()
         }
     }
 
-    lv_indev_set_group(my_indev, group);
-
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &lv_tick_task,
-        .name = "periodic_gui"};
-    esp_timer_handle_t periodic_timer;
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, LV_TICK_PERIOD_MS * 1000));
-}
+    lv_indev_set_group(keypad, group);
 
-static void update_label_timer(lv_timer_t * timer)
-{
-    static char week[7][5] = {"天", "一", "二", "三", "四", "五", "六"};
-
-    lv_obj_t** p = (lv_obj_t**)timer->user_data;
-    lv_obj_t* labelTime = *p;
-    lv_obj_t* labelDate = *(p + 1);
-
-    struct timeval tv;
-    struct tm timeinfo;
-
-    gettimeofday(&tv, NULL);
-    localtime_r(&tv.tv_sec, &timeinfo);
-
-    lv_label_set_text_fmt(
-        labelTime,
-        "%02d:%02d:%02d.%03ld",
-        timeinfo.tm_hour,
-        timeinfo.tm_min,
-        timeinfo.tm_sec,
-        tv.tv_usec / 1000
-    );
-    lv_label_set_text_fmt(
-        labelDate,
-        "%04d年%d月%02d 星期%s",
-        timeinfo.tm_year + 1900,
-        timeinfo.tm_mon + 1,
-        timeinfo.tm_mday,
-        week[timeinfo.tm_wday]
-    );
+    // No tick timer, LVGL reads esp_timer_get_time() when it needs the time
+    // (CONFIG_LV_TICK_CUSTOM in sdkconfig)
 }
 
 void app_main(void)
@@ -176,34 +212,11 @@ void app_main(void)
 
     my_sntp_init();
 
-    static lv_style_t styleTime, styleDate;
-    lv_style_init(&styleTime);
-    lv_style_set_text_color(&styleTime, lv_color_make(0, 0xa0, 0));
-    lv_style_set_text_font(&styleTime, &lv_font_montserrat_22);
-
-    lv_style_init(&styleDate);
-    lv_style_set_text_color(&styleDate, lv_color_make(0, 0xa0, 0));
-    lv_style_set_text_font(&styleDate, &lv_font_simsun_16_cjk);
-
-    lv_obj_t* labelTime = lv_label_create(lv_scr_act());
-    lv_label_set_text(labelTime, "");
-    lv_obj_center(labelTime);
-    lv_obj_align(labelTime, LV_ALIGN_LEFT_MID, 5, -10);
-    lv_obj_add_style(labelTime, &styleTime, 0);
-
-    lv_obj_t* labelDate = lv_label_create(lv_scr_act());
-    lv_label_set_text(labelDate, "");
-    lv_obj_align_to(labelDate, labelTime, LV_ALIGN_BOTTOM_LEFT, 0, 15);
-    lv_obj_add_style(labelDate, &styleDate, 0);
-
-    lv_obj_t* labels[] = {labelTime, labelDate};
-    lv_timer_t * timer = lv_timer_create(update_label_timer, 1, &labels);
-    lv_timer_ready(timer);
-
-    while (1)
-    {
-        lv_task_handler();
-        vTaskDelay(pdMS_TO_TICKS(1));
-    }
+    clock_ui_create(lv_scr_act());
+    sync_changed();
+#if CLOCK_BENCH
+    bench_monitor_start();
+#endif
 
+    ui_loop_run(ui_event_cb);
 }
@@ -1,10 +1,18 @@
-/* LwIP SNTP example
+/* Time service
 
-   This example code is in the Public Domain (or CC0 licensed, at your option.)
+   Gets the time over SNTP on a task of its own, the UI runs from the start
+   and shows whatever the system clock says until then. At boot the clock is
+   restored from the last sync (time_store.c), the next sync is when the
+   clock discipline (clock_disc.c) plans it: once the estimated error would
+   pass TIME_STORE_MAX_ERROR_MS, later the better the rate of the clock is
+   known. Wi-Fi is only up while a sync is in progress: connect, wait for the
+   SNTP reply, disconnect. Getting an address is bounded by
+   MY_SNTP_CONNECT_MS, the example's example_connect() would wait for an AP
+   forever with the radio on. A failed attempt is retried after
+   MY_SNTP_RETRY_MS, doubled on every failure up to MY_SNTP_RETRY_MAX_MS.
 
-   Unless required by applicable law or agreed to in writing, this
-   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
-   CONDITIONS OF ANY KIND, either express or implied.
+   Based on the LwIP SNTP example, which is in the Public Domain (or CC0
+   licensed, at your option).
 */
 #include <string.h>
 #include <time.h>
@@ -17,78 +25,110 @@
 #include "esp_log.h"
 #include "esp_attr.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
 #include "nvs_flash.h"
-#include "protocol_examples_common.h"
 #include "esp_sntp.h"
 #include "my_sntp.h"
+#include "time_store.h"
+#include "ui_loop.h"
 
 static const char *TAG = "my-sntp";
 
-static void obtain_time(void);
+#define MY_SNTP_GOT_IP_BIT  BIT0
+
+static TaskHandle_t my_sntp_task_handle;
+static volatile my_sntp_state_t my_sntp_current = MY_SNTP_UNSYNCED;
+static EventGroupHandle_t my_sntp_events;
+// Reconnect after a disconnect, only while an attempt wants the station up
+static volatile bool my_sntp_wifi_wanted;
+
 static void initialize_sntp(void);
 
-#ifdef CONFIG_SNTP_TIME_SYNC_METHOD_CUSTOM
+// Replaces the weak one of esp_sntp, the time store slews small offsets and learns the rate
+// of the clock from them
 void sntp_sync_time(struct timeval *tv)
 {
-   settimeofday(tv, NULL);
-   ESP_LOGI(TAG, "Time is synchronized from custom code");
-   sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+    time_store_synced(tv);
+    sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
 }
-#endif
 
 void time_sync_notification_cb(struct timeval *tv)
 {
     ESP_LOGI(TAG, "Notification of a time synchronization event");
+    ui_loop_post(UI_LOOP_EVENT_TIME);
+    xTaskNotifyGive(my_sntp_task_handle);
 }
 
-void my_sntp_init(void)
+const char *my_sntp_state_name(my_sntp_state_t state)
+{
+    static const char *const names[] = {"unsynced", "connecting", "syncing", "synced", "resync due"};
+
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "?";
+}
+
+my_sntp_state_t my_sntp_state(void)
+{
+    return my_sntp_current;
+}
+
+static void set_state(my_sntp_state_t state)
+{
+    if (state == my_sntp_current)
+        return;
+    ESP_LOGI(TAG, "%s -> %s", my_sntp_state_name(my_sntp_current), my_sntp_state_name(state));
+    my_sntp_current = state;
+    ui_loop_post(UI_LOOP_EVENT_SYNC);
+}
+
+static void log_time(void)
 {
     time_t now;
     struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    // Is time set? If not, tm_year will be (1970 - 1900).
-    if (timeinfo.tm_year < (2016 - 1900)) {
-        ESP_LOGI(TAG, "Time is not set yet. Connecting to WiFi and getting time over NTP.");
-        obtain_time();
-        // update 'now' variable with current time
-        time(&now);
-    }
-
     char strftime_buf[64];
 
-    // Set timezone to Eastern Standard Time and print local time
-    setenv("TZ", "EST5EDT,M3.2.0/2,M11.1.0", 1);
-    tzset();
-    localtime_r(&now, &timeinfo);
-    strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
-    ESP_LOGI(TAG, "The current date/time in New York is: %s", strftime_buf);
-
-    // Set timezone to China Standard Time
-    setenv("TZ", "CST-8", 1);
-    tzset();
+    time(&now);
     localtime_r(&now, &timeinfo);
     strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
     ESP_LOGI(TAG, "The current date/time in Shanghai is: %s", strftime_buf);
+}
 
-    if (sntp_get_sync_mode() == SNTP_SYNC_MODE_SMOOTH) {
-        struct timeval outdelta;
-        while (sntp_get_sync_status() == SNTP_SYNC_STATUS_IN_PROGRESS) {
-            adjtime(NULL, &outdelta);
-            ESP_LOGI(TAG, "Waiting for adjusting time ... outdelta = %li sec: %li ms: %li us",
-                        (long)outdelta.tv_sec,
-                        outdelta.tv_usec/1000,
-                        outdelta.tv_usec%1000);
-            vTaskDelay(2000 / portTICK_PERIOD_MS);
-        }
+static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (base == WIFI_EVENT && (id == WIFI_EVENT_STA_START || id == WIFI_EVENT_STA_DISCONNECTED))
+    {
+        if (my_sntp_wifi_wanted)
+            esp_wifi_connect();
     }
+    else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP)
+        xEventGroupSetBits(my_sntp_events, MY_SNTP_GOT_IP_BIT);
 }
 
-static void obtain_time(void)
+// Station with the SSID and password of menuconfig (protocol_examples_common's options),
+// initialized once and only started for an attempt
+static void wifi_init(void)
 {
-    ESP_ERROR_CHECK( nvs_flash_init() );
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = CONFIG_EXAMPLE_WIFI_SSID,
+            .password = CONFIG_EXAMPLE_WIFI_PASSWORD,
+            .scan_method = WIFI_ALL_CHANNEL_SCAN,
+            .sort_method = WIFI_CONNECT_AP_BY_SIGNAL,
+        },
+    };
+
+    my_sntp_events = xEventGroupCreate();
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK( esp_event_loop_create_default() );
+    esp_netif_create_default_wifi_sta();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
 
     /**
      * NTP server address could be aquired via DHCP,
@@ -97,28 +137,131 @@ static void obtain_time(void)
 #ifdef LWIP_DHCP_GET_NTP_SRV
     sntp_servermode_dhcp(1);
 #endif
+}
 
-    /* This helper function configures Wi-Fi or Ethernet, as selected in menuconfig.
-     * Read "Establishing Wi-Fi or Ethernet Connection" section in
-     * examples/protocols/README.md for more information about this function.
-     */
-    ESP_ERROR_CHECK(example_connect());
+// Radio off until the next attempt
+static void wifi_disconnect(void)
+{
+    my_sntp_wifi_wanted = false;
+    esp_wifi_disconnect();
+    ESP_ERROR_CHECK(esp_wifi_stop());
+}
 
+// Starts the station and waits up to MY_SNTP_CONNECT_MS for an address, stops it again if
+// none came
+static bool wifi_connect(void)
+{
+    EventBits_t bits;
+
+    xEventGroupClearBits(my_sntp_events, MY_SNTP_GOT_IP_BIT);
+    my_sntp_wifi_wanted = true;
+    ESP_ERROR_CHECK(esp_wifi_start());
+    bits = xEventGroupWaitBits(my_sntp_events, MY_SNTP_GOT_IP_BIT, pdFALSE, pdTRUE,
+                               pdMS_TO_TICKS(MY_SNTP_CONNECT_MS));
+    if (bits & MY_SNTP_GOT_IP_BIT)
+        return true;
+    wifi_disconnect();
+    return false;
+}
+
+// One attempt: Wi-Fi up, wait for the SNTP reply, Wi-Fi down
+static bool obtain_time(void)
+{
+    static bool wifi_ready = false;
+    bool synced;
+
+    set_state(MY_SNTP_CONNECTING);
+    if (!wifi_ready)
+    {
+        wifi_init();
+        wifi_ready = true;
+    }
+
+    if (!wifi_connect())
+    {
+        ESP_LOGW(TAG, "No address from %s in %d ms", CONFIG_EXAMPLE_WIFI_SSID, MY_SNTP_CONNECT_MS);
+        return false;
+    }
+
+    set_state(MY_SNTP_SYNCING);
+    ulTaskNotifyTake(pdTRUE, 0);
     initialize_sntp();
+    synced = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MY_SNTP_TIMEOUT_MS)) != 0;
+    // The service resyncs by itself, lwIP's periodic update would find no network
+    sntp_stop();
 
-    // wait for time to be set
-    time_t now = 0;
-    struct tm timeinfo = { 0 };
-    int retry = 0;
-    const int retry_count = 10;
-    while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
+    wifi_disconnect();
+    if (!synced)
+        ESP_LOGW(TAG, "No reply in %d ms", MY_SNTP_TIMEOUT_MS);
+    return synced;
+}
+
+// vTaskDelay for long times, pdMS_TO_TICKS overflows past 2^32 / configTICK_RATE_HZ ms
+static void delay_ms(uint32_t ms)
+{
+    vTaskDelay(ms / portTICK_PERIOD_MS);
+}
+
+static void my_sntp_task(void *arg)
+{
+    // Where a failed attempt goes back to, unsynced until the clock was set once. A time
+    // restored at boot counts as set, but a failed sync can't leave it reported as synced
+    my_sntp_state_t idle = my_sntp_current == MY_SNTP_UNSYNCED ? MY_SNTP_UNSYNCED : MY_SNTP_RESYNC_DUE;
+    uint32_t retry_ms = MY_SNTP_RETRY_MS;
+    bool first = true;
+
+    while (1)
+    {
+        if (my_sntp_current == MY_SNTP_SYNCED)
+        {
+            uint32_t ms = time_store_valid_ms();
+
+            ESP_LOGI(TAG, "Next sync in %u s", (unsigned)(ms / 1000));
+            delay_ms(ms);
+            set_state(MY_SNTP_RESYNC_DUE);
+        }
+
+        if (!obtain_time())
+        {
+            set_state(idle);
+            delay_ms(retry_ms);
+            retry_ms = retry_ms * 2 < MY_SNTP_RETRY_MAX_MS ? retry_ms * 2 : MY_SNTP_RETRY_MAX_MS;
+            continue;
+        }
+
+        if (first)
+        {
+            ESP_LOGI(TAG, "synced %u ms after boot", (unsigned)(esp_timer_get_time() / 1000));
+            first = false;
+        }
+        time_store_save();
+        idle = MY_SNTP_RESYNC_DUE;
+        log_time();
+        set_state(MY_SNTP_SYNCED);
+        retry_ms = MY_SNTP_RETRY_MS;
     }
-    time(&now);
-    localtime_r(&now, &timeinfo);
+}
+
+void my_sntp_init(void)
+{
+    int32_t error;
+
+    // Set timezone to China Standard Time
+    setenv("TZ", "CST-8", 1);
+    tzset();
+
+    ESP_ERROR_CHECK( nvs_flash_init() );
+    error = time_store_restore();
+    if (error == TIME_STORE_UNKNOWN) {
+        ESP_LOGI(TAG, "Time is not known. Connecting to WiFi and getting time over NTP.");
+        my_sntp_current = MY_SNTP_UNSYNCED;
+    } else {
+        ESP_LOGI(TAG, "Time restored, about %d ms off", (int)error);
+        my_sntp_current = time_store_valid_ms() ? MY_SNTP_SYNCED : MY_SNTP_RESYNC_DUE;
+    }
+    log_time();
 
-    ESP_ERROR_CHECK( example_disconnect() );
+    xTaskCreate(my_sntp_task, "sntp", MY_SNTP_STACK, NULL, tskIDLE_PRIORITY + 1, &my_sntp_task_handle);
 }
 
 static void initialize_sntp(void)
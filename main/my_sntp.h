@@ -1,3 +1,24 @@
 #pragma once
 
+// States of the time service, every change is posted to the UI loop as UI_LOOP_EVENT_SYNC
+typedef enum {
+    MY_SNTP_UNSYNCED,       // the time is not known, never set or the last known one before a power loss
+    MY_SNTP_CONNECTING,     // Wi-Fi is coming up
+    MY_SNTP_SYNCING,        // waiting for the SNTP reply
+    MY_SNTP_SYNCED,
+    MY_SNTP_RESYNC_DUE,     // the planned sync is due, or the last one failed
+} my_sntp_state_t;
+
+// First retry after a failed sync, doubled after each failure up to MY_SNTP_RETRY_MAX_MS
+#define MY_SNTP_RETRY_MS        30000
+#define MY_SNTP_RETRY_MAX_MS    3600000
+// How long one attempt waits for an address from the AP before giving up, Wi-Fi off
+#define MY_SNTP_CONNECT_MS      15000
+// How long one sync waits for the SNTP reply
+#define MY_SNTP_TIMEOUT_MS      20000
+#define MY_SNTP_STACK           4096
+
+// Sets the time zone and starts the time service task, returns at once
 void my_sntp_init(void);
+my_sntp_state_t my_sntp_state(void);
+const char *my_sntp_state_name(my_sntp_state_t state);
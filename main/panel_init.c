@@ -0,0 +1,66 @@
+/* Panel init
+
+   ST7735 init is mostly waiting: 10 ms of reset, 150 ms after SWRESET, 500 ms
+   after SLPOUT, 10 ms after NORON and 100 ms after DISPON. Instead of sleeping
+   through them in ST7735_Init, the command lists are sent step by step from a
+   one shot esp_timer armed with the delay each step asks for, so the boot
+   carries on in the meantime. Nothing else may use the bus until the panel is
+   ready.
+*/
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "st7735.h"
+#include "panel_init.h"
+
+static const char *TAG = "panel";
+
+static ST77XX_Seq_t panel_seq;
+static esp_timer_handle_t panel_timer;
+static panel_init_ready_cb_t panel_ready_cb;
+static int64_t panel_start;
+static volatile bool panel_ready = false;
+
+static void panel_init_step(void *arg)
+{
+    int ms = ST7735_InitStep(&panel_seq);
+
+    if (ms >= 0)
+    {
+        ESP_ERROR_CHECK(esp_timer_start_once(panel_timer, ms * 1000LL));
+        return;
+    }
+    panel_ready = true;
+    ESP_LOGI(TAG, "ready in %u ms, %u ms after boot",
+             (unsigned)((esp_timer_get_time() - panel_start) / 1000),
+             (unsigned)(esp_timer_get_time() / 1000));
+    if (panel_ready_cb)
+        panel_ready_cb();
+}
+
+void panel_init_start(const ST77XX_Bus_t *bus, panel_init_ready_cb_t cb)
+{
+    const esp_timer_create_args_t args = {
+        .callback = panel_init_step,
+        .name = "panel_init",
+    };
+
+    ESP_ERROR_CHECK(esp_timer_create(&args, &panel_timer));
+    panel_ready_cb = cb;
+    panel_start = esp_timer_get_time();
+    ST7735_InitStart(bus, &panel_seq);
+    panel_init_step(NULL);
+}
+
+bool panel_init_ready(void)
+{
+    return panel_ready;
+}
+
+void panel_init_wait(void)
+{
+    while (!panel_ready)
+        vTaskDelay(1);
+}
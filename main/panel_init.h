@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+#include "st77xx_bus.h"
+
+// Called once the panel is on, from the esp_timer task
+typedef void (*panel_init_ready_cb_t)(void);
+
+// Starts ST7735 init on `bus` and returns after the first commands, the rest is sent from
+// an esp_timer after each of the panel's delays instead of blocking the caller for them
+void panel_init_start(const ST77XX_Bus_t *bus, panel_init_ready_cb_t cb);
+bool panel_init_ready(void);
+// Blocks until the panel is ready
+void panel_init_wait(void);
@@ -1,29 +1,33 @@
-#ifndef __ST7735_H
-#define __ST7735_H
-
-#include "st77xx.h"
-
-// Some register settings
-#define ST7735_FRMCTR1    0xB1
-#define ST7735_FRMCTR2    0xB2
-#define ST7735_FRMCTR3    0xB3
-#define ST7735_INVCTR     0xB4
-#define ST7735_DISSET5    0xB6
-
-#define ST7735_PWCTR1     0xC0
-#define ST7735_PWCTR2     0xC1
-#define ST7735_PWCTR3     0xC2
-#define ST7735_PWCTR4     0xC3
-#define ST7735_PWCTR5     0xC4
-#define ST7735_VMCTR1     0xC5
-
-#define ST7735_PWCTR6     0xFC
-
-#define ST7735_GMCTRP1    0xE0
-#define ST7735_GMCTRN1    0xE1
-
-
-void ST7735_Init(void);
-
-
-#endif
+#ifndef __ST7735_H
+#define __ST7735_H
+
+#include "st77xx.h"
+
+// Some register settings
+#define ST7735_FRMCTR1    0xB1
+#define ST7735_FRMCTR2    0xB2
+#define ST7735_FRMCTR3    0xB3
+#define ST7735_INVCTR     0xB4
+#define ST7735_DISSET5    0xB6
+
+#define ST7735_PWCTR1     0xC0
+#define ST7735_PWCTR2     0xC1
+#define ST7735_PWCTR3     0xC2
+#define ST7735_PWCTR4     0xC3
+#define ST7735_PWCTR5     0xC4
+#define ST7735_VMCTR1     0xC5
+
+#define ST7735_PWCTR6     0xFC
+
+#define ST7735_GMCTRP1    0xE0
+#define ST7735_GMCTRN1    0xE1
+
+
+void ST7735_Init(const ST77XX_Bus_t *bus);
+// Same without blocking: ST7735_InitStep sends the next commands and returns how many ms
+// to wait before calling it again, -1 once the panel is on and the backlight too
+void ST7735_InitStart(const ST77XX_Bus_t *bus, ST77XX_Seq_t *seq);
+int ST7735_InitStep(ST77XX_Seq_t *seq);
+
+
+#endif
@@ -1,442 +1,1378 @@
-/******************************************************************************
-** 
- * \file        st77xx.c
- * \author      IOsetting | iosetting@outlook.com
- * \date        
- * \brief       Library of ST77XX TFT LCD on W806
- * \note        
- * \version     v0.1
- * \ingroup     demo
- * \remarks     test-board: HLK-W806-KIT-V1.0
- *              
- *              B10   -> RES, RESET
- *              B11   -> DC, CD
- *              B14   -> CS, Chip Select
- *              B15   -> SCK, SCL, CLK, Clock
- *              B16   -> BL, Back Light
- *              B17   -> MOSI, SDA
- *              GND   -> GND
- *              3.3V  -> VCC
- * 
- *              ST77XX_HARDWARE_SPI - 0: Software SPI, 1: Hardware SPI
- * 
-******************************************************************************/
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "esp_system.h"
-#include "driver/spi_master.h"
-#include "driver/gpio.h"
-#include "st77xx.h"
-
-#define LCD_HOST    SPI2_HOST
-
-#define HAL_MAX_DELAY 0xffff
-
-//To speed up transfers, every SPI transfer sends a bunch of lines. This define specifies how many. More means more memory use,
-//but less overhead for setting up / finishing transfers. Make sure 240 is dividable by this.
-#define PARALLEL_LINES 16
-
-static uint8_t st77xx_buf[ST77XX_BUF_SIZE];
-static uint16_t st77xx_buf_pt = 0;
-
-
-#if ST77XX_HARDWARE_SPI
-spi_device_handle_t spiHander;
-
-//This function is called (in irq context!) just before a transmission starts. It will
-//set the D/C line to the value indicated in the user field.
-void lcd_spi_pre_transfer_callback(spi_transaction_t *trans)
-{
-    int dc= (int)trans->user;
-    gpio_set_level(ST77XX_DC_PIN, dc);
-}
-
-static void initSpi()
-{
-    esp_err_t ret;
-    spi_bus_config_t buscfg = {
-        .miso_io_num = -1,
-        .mosi_io_num = ST77XX_MOSI_PIN,
-        .sclk_io_num = ST77XX_SCK_PIN,
-        .quadwp_io_num = -1,
-        .quadhd_io_num = -1,
-        .max_transfer_sz = PARALLEL_LINES * ST77XX_WIDTH * 2 + 8
-    };
-    spi_device_interface_config_t devcfg={
-        .flags = SPI_DEVICE_HALFDUPLEX, // TX only
-        .clock_speed_hz = 40*1000*1000,           //Clock
-        .mode = 0,                                //SPI mode 0
-        .spics_io_num = ST77XX_CS_PIN,               //CS pin
-        .queue_size = 10,                          //We want to be able to queue 7 transactions at a time
-        .pre_cb = lcd_spi_pre_transfer_callback,  //Specify pre-transfer callback to handle D/C line
-        .post_cb = NULL,
-    };
-    //Initialize the SPI bus
-    ret = spi_bus_initialize(LCD_HOST, &buscfg, SPI_DMA_CH_AUTO);
-    ESP_ERROR_CHECK(ret);
-    //Attach the LCD to the SPI bus
-    ret = spi_bus_add_device(LCD_HOST, &devcfg, &spiHander);
-    ESP_ERROR_CHECK(ret);
-    printf("spi hander: %x\n", (void*)spiHander);
-}
-#endif
-
-void ST77XX_Init(void)
-{
-    gpio_config_t io_config = {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_down_en = 0,
-        .pull_up_en = 0,
-    };
-
-#if !ST77XX_HARDWARE_SPI
-    printf("init gpio cs sck mosi\n");
-    io_config.pin_bit_mask = (1ULL << ST77XX_CS_PIN)
-                            | (1ULL << ST77XX_SCK_PIN)
-                            | (1ULL << ST77XX_MOSI_PIN)
-                            | (1ULL << ST77XX_DC_PIN)
-                            | (1ULL << ST77XX_RES_PIN)
-                            | (1ULL << ST77XX_BL_PIN);
-#else
-    printf("init spi\n");
-    initSpi();
-    io_config.pin_bit_mask = (1ULL << ST77XX_DC_PIN)
-                            | (1ULL << ST77XX_RES_PIN)
-                            | (1ULL << ST77XX_BL_PIN);
-#endif
-
-    gpio_config(&io_config);
-}
-
-
-void ST77XX_Reset(void)
-{
-    ST77XX_RESET_LOW;
-    vTaskDelay(10 / portTICK_RATE_MS);
-    ST77XX_RESET_HIGH;
-}
-
-static void ST77XX_TransmitByte(uint8_t dat)
-{
-#if ST77XX_HARDWARE_SPI
-    // ST77XX_CS_LOW;
-    spi_transaction_t t = {
-        .length = 8,
-        .tx_buffer = &dat,
-        .user = (void*)0
-    };
-    ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t));
-    // ST77XX_CS_HIGH;
-#else
-    uint8_t i;
-    ST77XX_CS_LOW;
-    for (i = 0; i < 8; i++)
-    {
-        ST77XX_SCK_LOW;
-        if (dat & 0x80)
-        {
-            ST77XX_MOSI_HIGH;
-        }
-        else
-        {
-            ST77XX_MOSI_LOW;
-        }
-        ST77XX_SCK_HIGH;
-        dat <<= 1;
-    }
-    ST77XX_CS_HIGH;
-#endif
-}
-
-static void ST77XX_Transmit(const uint8_t *pData, uint32_t Size, uint32_t Timeout)
-{
-#if ST77XX_HARDWARE_SPI
-    // ST77XX_CS_LOW;
-    spi_transaction_t t = {
-        .length = Size * 8,
-        .tx_buffer = pData,
-        .user = (void*)1
-    };
-    ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t));
-    // ST77XX_CS_HIGH;
-#else
-    while (Size-- > 0)
-    {
-        ST77XX_TransmitByte(*(pData++));
-    }
-#endif
-}
-
-static void ST77XX_WriteCommand(uint8_t dat)
-{
-    ST77XX_DC_LOW;
-    ST77XX_TransmitByte(dat);
-    ST77XX_DC_HIGH;
-}
-
-static void ST77XX_WriteData(const uint8_t* buff, size_t buff_size)
-{
-    ST77XX_Transmit(buff, buff_size, HAL_MAX_DELAY);
-}
-
-static void ST77XX_WriteBuff(uint8_t* buff, size_t buff_size)
-{
-    while (buff_size--)
-    {
-        st77xx_buf[st77xx_buf_pt++] = *buff++;
-        if (st77xx_buf_pt == ST77XX_BUF_SIZE)
-        {
-            ST77XX_Transmit(st77xx_buf, st77xx_buf_pt, HAL_MAX_DELAY);
-            st77xx_buf_pt = 0;
-        }
-    }
-}
-
-static void ST77XX_FlushBuff(void)
-{
-    if (st77xx_buf_pt > 0)
-    {
-        ST77XX_Transmit(st77xx_buf, st77xx_buf_pt, HAL_MAX_DELAY);
-        st77xx_buf_pt = 0;
-    }
-}
-
-void ST77XX_ExecuteCommandList(const uint8_t *addr)
-{
-    uint8_t numCommands, numArgs;
-    uint16_t ms;
-
-    numCommands = *addr++;
-    while (numCommands--)
-    {
-        uint8_t cmd = *addr++;
-        ST77XX_WriteCommand(cmd);
-
-        numArgs = *addr++;
-        // If high bit set, delay follows args
-        ms = numArgs & ST77XX_CMD_DELAY;
-        numArgs &= ~ST77XX_CMD_DELAY;
-        if (numArgs)
-        {
-            ST77XX_WriteData(addr, numArgs);
-            addr += numArgs;
-        }
-
-        if (ms)
-        {
-            ms = *addr++;
-            if (ms == 255)
-                ms = 500;
-            vTaskDelay(ms / portTICK_RATE_MS);
-        }
-    }
-}
-
-static void ST77XX_SetAddrWindow(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
-{
-    // column address set
-    ST77XX_WriteCommand(ST77XX_CASET);
-    x1 = x1 + ST77XX_XSTART;
-    x2 = x2 + ST77XX_XSTART;
-    uint8_t data[] = { x1 >> 8, x1 & 0xFF, x2 >> 8, x2 % 0xFF };
-    ST77XX_WriteData(data, sizeof(data));
-
-    // row address set
-    ST77XX_WriteCommand(ST77XX_RASET);
-    y1 = y1 + ST77XX_YSTART;
-    y2 = y2 + ST77XX_YSTART;
-    data[0] = y1 >> 8;
-    data[1] = y1 & 0xFF;
-    data[2] = y2 >> 8;
-    data[3] = y2 & 0xFF;
-    ST77XX_WriteData(data, sizeof(data));
-
-    // write to RAM
-    ST77XX_WriteCommand(ST77XX_RAMWR);
-}
-
-void ST77XX_BackLight_On(void)
-{
-    ST77XX_BL_HIGH;
-}
-
-void ST77XX_BackLight_Off(void)
-{
-    ST77XX_BL_LOW;
-}
-
-void ST77XX_Fill(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color)
-{
-    uint16_t i,j;
-    ST77XX_SetAddrWindow(x_start, y_start, x_end - 1, y_end - 1);
-    for(i = y_start; i < y_end; i++)
-    {
-        for( j = x_start; j < x_end; j++)
-        {
-            ST77XX_WriteBuff((uint8_t *)&color, 2);
-        }
-    }
-    ST77XX_FlushBuff();
-}
-
-void ST77XX_DrawPoint(uint16_t x, uint16_t y, uint16_t color)
-{
-    ST77XX_SetAddrWindow( x, y, x, y);
-    ST77XX_WriteData((uint8_t *)&color, 2);
-}
-
-void ST77XX_DrawLine(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color)
-{
-    uint16_t t;
-    int xerr = 0, yerr=0, delta_x, delta_y, distance;
-    int incx, incy, uRow, uCol;
-    delta_x = x_end - x_start; //计算坐标增量 
-    delta_y = y_end - y_start;
-    uRow = x_start;//画线起点坐标
-    uCol = y_start;
-
-    if (delta_x > 0)
-        incx = 1; //设置单步方向 
-    else if (delta_x == 0)
-        incx=0; //垂直线
-    else
-    {
-        incx = -1;
-        delta_x = -delta_x;
-    }
-
-    if (delta_y > 0)
-        incy = 1;
-    else if (delta_y == 0)
-        incy=0; //水平线 
-    else
-    {
-        incy = -1;
-        delta_y = -delta_y;
-    }
-    
-    if (delta_x > delta_y)
-        distance = delta_x; //选取基本增量坐标轴 
-    else
-        distance = delta_y;
-
-    for (t = 0; t < distance + 1; t++)
-    {
-        ST77XX_DrawPoint(uRow, uCol, color);
-        xerr += delta_x;
-        yerr += delta_y;
-        if(xerr > distance)
-        {
-            xerr -= distance;
-            uRow += incx;
-        }
-        if(yerr>distance)
-        {
-            yerr -= distance;
-            uCol += incy;
-        }
-    }
-}
-
-void ST77XX_DrawRectangle(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color)
-{
-    ST77XX_DrawLine(x_start, y_start, x_end,   y_start, color);
-    ST77XX_DrawLine(x_start, y_start, x_start, y_end,   color);
-    ST77XX_DrawLine(x_start, y_end,   x_end,   y_end,   color);
-    ST77XX_DrawLine(x_end,   y_start, x_end,   y_end,   color);
-}
-
-void ST77XX_DrawCircle(uint16_t x, uint16_t y, uint8_t radius, uint16_t color)
-{
-    int a = 0, b = radius;
-    while (a <= b)
-    {
-        ST77XX_DrawPoint(x - b, y - a, color);
-        ST77XX_DrawPoint(x - b, y + a, color);
-        ST77XX_DrawPoint(x + b, y - a, color);
-        ST77XX_DrawPoint(x + b, y + a, color);
-        ST77XX_DrawPoint(x + a, y - b, color);
-        ST77XX_DrawPoint(x - a, y - b, color);
-        ST77XX_DrawPoint(x + a, y + b, color);
-        ST77XX_DrawPoint(x - a, y + b, color);
-        a++;
-        if ((a * a + b * b) > (radius * radius))
-        {
-            b--;
-        }
-    }
-}
-
-void ST77XX_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *data)
-{
-    if ((x >= ST77XX_WIDTH) || (y >= ST77XX_HEIGHT))
-        return;
-    if ((x + w - 1) >= ST77XX_WIDTH)
-        return;
-    if ((y + h - 1) >= ST77XX_HEIGHT)
-        return;
-
-    ST77XX_SetAddrWindow(x, y, x + w - 1, y + h - 1);
-    ST77XX_WriteData((uint8_t *)data, sizeof(uint16_t) * w * h);
-}
-
-void ST77XX_DrawChar(uint16_t x, uint16_t y, char ch, FontDef_t* font, uint16_t color, uint16_t bgcolor)
-{
-    uint8_t b, i, j, k, bytes;
-
-    ST77XX_SetAddrWindow(x, y, x + font->width - 1, y + font->height - 1);
-    bytes = font->width / 8 + ((font->width % 8)? 1 : 0);
-
-    for (i = 0; i < font->height; i++)
-    {
-        for (j = 0; j < bytes; j++)
-        {
-            b = font->data[((ch - 32) * font->height + i) * bytes + j];
-            if (font->order == 0)
-            {
-                for (k = 0; k < 8 && k < font->width - j * 8; k++)
-                {
-                    if ((b << k) & 0x80)
-                    {
-                        ST77XX_WriteBuff((uint8_t *)&color, 2);
-                    }
-                    else
-                    {
-                        ST77XX_WriteBuff((uint8_t *)&bgcolor, 2);
-                    }
-                }
-            }
-            else
-            {
-                for (k = 0; k < 8 && k < font->width - j * 8; k++)
-                {
-                    if (b & (0x0001 << k))
-                    {
-                        ST77XX_WriteBuff((uint8_t *)&color, 2);
-                    }
-                    else
-                    {
-                        ST77XX_WriteBuff((uint8_t *)&bgcolor, 2);
-                    }
-                }
-            }
-        }
-
-    }
-    ST77XX_FlushBuff();
-}
-
-void ST77XX_DrawString(uint16_t x, uint16_t y, const char *p, FontDef_t* font, uint16_t color, uint16_t bgcolor)
-{
-    while (*p != '\0')
-    {
-        ST77XX_DrawChar(x, y, *p, font, color, bgcolor);
-        x += font->width;
-        p++;
-    }
-}
+/******************************************************************************
+** 
+ * \file        st77xx.c
+ * \author      IOsetting | iosetting@outlook.com
+ * \date        
+ * \brief       Library of ST77XX TFT LCD on W806
+ * \note        
+ * \version     v0.1
+ * \ingroup     demo
+ * \remarks     test-board: HLK-W806-KIT-V1.0
+ *              
+ *              B10   -> RES, RESET
+ *              B11   -> DC, CD
+ *              B14   -> CS, Chip Select
+ *              B15   -> SCK, SCL, CLK, Clock
+ *              B16   -> BL, Back Light
+ *              B17   -> MOSI, SDA
+ *              GND   -> GND
+ *              3.3V  -> VCC
+ * 
+ *              The panel is reached through an ST77XX_Bus_t, see st77xx_bus.h
+ * 
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "st77xx.h"
+
+//Word aligned so glyph rows can be expanded into it with word stores
+static uint8_t st77xx_buf[ST77XX_BUF_SIZE] __attribute__((aligned(4)));
+static uint16_t st77xx_buf_pt = 0;
+
+static const ST77XX_Bus_t *st77xx_bus = NULL;
+
+ST77XX_Stats_t st77xx_stats;
+
+//Last window sent to the panel, CASET/RASET are skipped when they wouldn't change it
+static bool st77xx_batch_window = true;
+static uint16_t st77xx_win_x1 = 0xFFFF, st77xx_win_x2 = 0xFFFF;
+static uint16_t st77xx_win_y1 = 0xFFFF, st77xx_win_y2 = 0xFFFF;
+
+//RGB444 wire format. Pixels are packed two at a time into 3 bytes, an odd pixel left at
+//the end of a write call waits in st77xx_pack_carry for the next one.
+static bool st77xx_rgb444 = ST77XX_RGB444;
+static bool st77xx_pack_odd = false;
+static uint16_t st77xx_pack_carry;
+
+#if ST77XX_SHADOW_GRAM
+//Copy of what the panel shows, kept by ST77XX_DrawImageDiff. Columns inv_x1..inv_x2 of a
+//row were written by other drawing calls and are not known to match the panel.
+static uint16_t st77xx_shadow[ST77XX_HEIGHT][ST77XX_WIDTH];
+static uint16_t st77xx_inv_x1[ST77XX_HEIGHT];
+static uint16_t st77xx_inv_x2[ST77XX_HEIGHT];
+
+typedef struct {
+    uint16_t x1;
+    uint16_t x2;
+} ST77XX_Span_t;
+
+static ST77XX_Span_t st77xx_spans[ST77XX_WIDTH / 2 + 1];
+
+static void ST77XX_ShadowInvalidate(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2);
+#endif
+
+void ST77XX_SetWindowBatching(bool enable)
+{
+    st77xx_batch_window = enable;
+}
+
+void ST77XX_GetStats(ST77XX_Stats_t *stats)
+{
+    *stats = st77xx_stats;
+}
+
+void ST77XX_ResetStats(void)
+{
+    memset(&st77xx_stats, 0, sizeof(st77xx_stats));
+}
+
+void ST77XX_WaitAsync(void)
+{
+    st77xx_bus->wait();
+}
+
+void ST77XX_Init(const ST77XX_Bus_t *bus)
+{
+    st77xx_bus = bus;
+    st77xx_bus->init();
+#if ST77XX_SHADOW_GRAM
+    //Nothing is known about the panel contents yet
+    ST77XX_ShadowInvalidate(0, 0, ST77XX_WIDTH - 1, ST77XX_HEIGHT - 1);
+#endif
+}
+
+
+void ST77XX_Reset(void)
+{
+    st77xx_bus->set_reset(false);
+    st77xx_bus->delay_ms(10);
+    st77xx_bus->set_reset(true);
+}
+
+static void ST77XX_WriteCommand(uint8_t dat)
+{
+    st77xx_bus->write_command(dat);
+}
+
+//Blocking, in pieces the bus takes
+static void ST77XX_WriteData(const uint8_t* buff, size_t buff_size)
+{
+    size_t size;
+
+    while (buff_size > 0)
+    {
+        size = buff_size > ST77XX_BUS_MAX_WRITE ? ST77XX_BUS_MAX_WRITE : buff_size;
+        st77xx_bus->write_data(buff, size);
+        buff += size;
+        buff_size -= size;
+    }
+}
+
+static void ST77XX_FlushBuff(void)
+{
+    if (st77xx_buf_pt > 0)
+    {
+        ST77XX_WriteData(st77xx_buf, st77xx_buf_pt);
+        st77xx_buf_pt = 0;
+    }
+}
+
+//12 bits of one RGB565 pixel, kept in wire byte order like every color here
+static inline uint16_t ST77XX_To444(uint16_t c)
+{
+    uint8_t hi = c & 0xFF, lo = c >> 8;
+    return ((hi & 0xF0) << 4) | ((hi & 0x07) << 5) | ((lo & 0x80) >> 3) | ((lo >> 1) & 0x0F);
+}
+
+//Packs n pixels, n even, into n * 3 / 2 bytes. dst may be src itself, the writes never
+//catch up with the reads.
+static void ST77XX_Pack444(uint8_t *dst, const uint16_t *src, uint32_t n)
+{
+    uint16_t a, b;
+
+    for (; n >= 2; n -= 2, src += 2, dst += 3)
+    {
+        a = ST77XX_To444(src[0]);
+        b = ST77XX_To444(src[1]);
+        dst[0] = a >> 4;
+        dst[1] = (a << 4) | (b >> 8);
+        dst[2] = b;
+    }
+}
+
+//Bytes n pixels take on the wire, the last odd one in RGB444 mode is padded to 2 bytes
+static uint32_t ST77XX_WireBytes(uint32_t n)
+{
+    return st77xx_rgb444 ? (n * 3 + 1) / 2 : n * sizeof(uint16_t);
+}
+
+//Streams pixels through the transmit buffer in the wire format
+static void ST77XX_WritePixels(const uint16_t *src, uint32_t n)
+{
+    uint32_t chunk;
+    uint16_t pair[2];
+
+    if (!st77xx_rgb444)
+    {
+        while (n > 0)
+        {
+            if (st77xx_buf_pt == ST77XX_BUF_SIZE)
+                ST77XX_FlushBuff();
+            chunk = (ST77XX_BUF_SIZE - st77xx_buf_pt) / sizeof(uint16_t);
+            if (chunk > n)
+                chunk = n;
+            memcpy(&st77xx_buf[st77xx_buf_pt], src, chunk * sizeof(uint16_t));
+            st77xx_buf_pt += chunk * sizeof(uint16_t);
+            src += chunk;
+            n -= chunk;
+        }
+        return;
+    }
+
+    if (st77xx_pack_odd && n > 0)
+    {
+        if (st77xx_buf_pt + 3 > ST77XX_BUF_SIZE)
+            ST77XX_FlushBuff();
+        pair[0] = st77xx_pack_carry;
+        pair[1] = *src++;
+        ST77XX_Pack444(&st77xx_buf[st77xx_buf_pt], pair, 2);
+        st77xx_buf_pt += 3;
+        st77xx_pack_odd = false;
+        n--;
+    }
+    while (n >= 2)
+    {
+        if (st77xx_buf_pt + 3 > ST77XX_BUF_SIZE)
+            ST77XX_FlushBuff();
+        chunk = (ST77XX_BUF_SIZE - st77xx_buf_pt) / 3 * 2;
+        if (chunk > (n & ~1))
+            chunk = n & ~1;
+        ST77XX_Pack444(&st77xx_buf[st77xx_buf_pt], src, chunk);
+        st77xx_buf_pt += chunk / 2 * 3;
+        src += chunk;
+        n -= chunk;
+    }
+    if (n)
+    {
+        st77xx_pack_carry = *src;
+        st77xx_pack_odd = true;
+    }
+}
+
+//Ends a run of ST77XX_WritePixels, a carried over pixel goes out padded
+static void ST77XX_EndPixels(void)
+{
+    uint16_t c;
+
+    if (st77xx_pack_odd)
+    {
+        if (st77xx_buf_pt + 2 > ST77XX_BUF_SIZE)
+            ST77XX_FlushBuff();
+        c = ST77XX_To444(st77xx_pack_carry);
+        st77xx_buf[st77xx_buf_pt++] = c >> 4;
+        st77xx_buf[st77xx_buf_pt++] = c << 4;
+        st77xx_pack_odd = false;
+    }
+    ST77XX_FlushBuff();
+}
+
+//Image of n pixels ready to send as is. In RGB444 mode it is packed in place, the caller
+//hands the buffer over until the write is done.
+static const uint8_t *ST77XX_PackImage(const uint16_t *data, uint32_t n)
+{
+    uint8_t *dst = (uint8_t *)data;
+    uint16_t c;
+
+    if (!st77xx_rgb444)
+        return dst;
+    ST77XX_Pack444(dst, data, n & ~1);
+    if (n & 1)
+    {
+        c = ST77XX_To444(data[n - 1]);
+        dst[(n - 1) / 2 * 3] = c >> 4;
+        dst[(n - 1) / 2 * 3 + 1] = c << 4;
+    }
+    return dst;
+}
+
+void ST77XX_SeqStart(ST77XX_Seq_t *seq, const uint8_t *const *lists, bool reset)
+{
+    seq->lists = lists;
+    seq->addr = NULL;
+    seq->commands = 0;
+    seq->reset = reset ? 2 : 0;
+}
+
+int ST77XX_SeqStep(ST77XX_Seq_t *seq)
+{
+    uint8_t numArgs;
+    int ms;
+
+    // Reset pulse, the line is released on the next step
+    if (seq->reset == 2)
+    {
+        seq->reset = 1;
+        st77xx_bus->set_reset(false);
+        return 10;
+    }
+    if (seq->reset == 1)
+    {
+        seq->reset = 0;
+        st77xx_bus->set_reset(true);
+    }
+    if (seq->lists == NULL)
+        return -1;
+
+    while (1)
+    {
+        while (seq->commands == 0)
+        {
+            if (seq->addr != NULL)
+                seq->lists++;
+            if (*seq->lists == NULL)
+            {
+                seq->lists = NULL;
+                return -1;
+            }
+            // The lists may set the window themselves
+            st77xx_win_x1 = st77xx_win_x2 = st77xx_win_y1 = st77xx_win_y2 = 0xFFFF;
+            seq->addr = *seq->lists;
+            seq->commands = *seq->addr++;
+        }
+
+        seq->commands--;
+        ST77XX_WriteCommand(*seq->addr++);
+
+        numArgs = *seq->addr++;
+        // If high bit set, delay follows args
+        ms = numArgs & ST77XX_CMD_DELAY;
+        numArgs &= ~ST77XX_CMD_DELAY;
+        if (numArgs)
+        {
+            ST77XX_WriteData(seq->addr, numArgs);
+            seq->addr += numArgs;
+        }
+
+        if (ms)
+        {
+            ms = *seq->addr++;
+            if (ms == 255)
+                ms = 500;
+            return ms;
+        }
+    }
+}
+
+void ST77XX_ExecuteCommandList(const uint8_t *addr)
+{
+    const uint8_t *lists[] = {addr, NULL};
+    ST77XX_Seq_t seq;
+    int ms;
+
+    ST77XX_SeqStart(&seq, lists, false);
+    while ((ms = ST77XX_SeqStep(&seq)) >= 0)
+        st77xx_bus->delay_ms(ms);
+}
+
+static void ST77XX_SetAddrWindowRaw(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+    x1 = x1 + ST77XX_XSTART;
+    x2 = x2 + ST77XX_XSTART;
+    y1 = y1 + ST77XX_YSTART;
+    y2 = y2 + ST77XX_YSTART;
+    st77xx_stats.windows++;
+
+    if (st77xx_batch_window && st77xx_bus->write_window)
+    {
+        st77xx_bus->write_window(x1, y1, x2, y2,
+                                 (x1 != st77xx_win_x1) || (x2 != st77xx_win_x2),
+                                 (y1 != st77xx_win_y1) || (y2 != st77xx_win_y2));
+        st77xx_win_x1 = x1;
+        st77xx_win_x2 = x2;
+        st77xx_win_y1 = y1;
+        st77xx_win_y2 = y2;
+        return;
+    }
+
+    // column address set
+    ST77XX_WriteCommand(ST77XX_CASET);
+    uint8_t data[] = { x1 >> 8, x1 & 0xFF, x2 >> 8, x2 & 0xFF };
+    ST77XX_WriteData(data, sizeof(data));
+
+    // row address set
+    ST77XX_WriteCommand(ST77XX_RASET);
+    data[0] = y1 >> 8;
+    data[1] = y1 & 0xFF;
+    data[2] = y2 >> 8;
+    data[3] = y2 & 0xFF;
+    ST77XX_WriteData(data, sizeof(data));
+
+    // write to RAM
+    ST77XX_WriteCommand(ST77XX_RAMWR);
+
+    st77xx_win_x1 = x1;
+    st77xx_win_x2 = x2;
+    st77xx_win_y1 = y1;
+    st77xx_win_y2 = y2;
+}
+
+#if ST77XX_SHADOW_GRAM
+static void ST77XX_ShadowInvalidate(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+    uint16_t y;
+
+    for (y = y1; y <= y2 && y < ST77XX_HEIGHT; y++)
+    {
+        if (st77xx_inv_x1[y] > st77xx_inv_x2[y])
+        {
+            st77xx_inv_x1[y] = x1;
+            st77xx_inv_x2[y] = x2;
+        }
+        else
+        {
+            if (x1 < st77xx_inv_x1[y])
+                st77xx_inv_x1[y] = x1;
+            if (x2 > st77xx_inv_x2[y])
+                st77xx_inv_x2[y] = x2;
+        }
+    }
+}
+
+//Columns x..x+w-1 of row y match the panel again
+static void ST77XX_ShadowValidate(uint16_t x, uint16_t y, uint16_t w)
+{
+    uint16_t inv1 = st77xx_inv_x1[y], inv2 = st77xx_inv_x2[y];
+
+    if (inv1 > inv2)
+        return;
+    if (x <= inv1 && x + w - 1 >= inv2)
+    {
+        st77xx_inv_x1[y] = 1;
+        st77xx_inv_x2[y] = 0;
+    }
+    else if (x <= inv1 && x + w - 1 >= inv1)
+    {
+        st77xx_inv_x1[y] = x + w;
+    }
+    else if (x <= inv2 && x + w - 1 >= inv2)
+    {
+        st77xx_inv_x2[y] = x - 1;
+    }
+}
+
+//True if the whole box is known to match the panel
+static bool ST77XX_ShadowValid(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+    uint16_t y;
+
+    for (y = y1; y <= y2; y++)
+    {
+        if (st77xx_inv_x1[y] <= st77xx_inv_x2[y] && st77xx_inv_x1[y] <= x2 && st77xx_inv_x2[y] >= x1)
+            return false;
+    }
+    return true;
+}
+
+static void ST77XX_ShadowFill(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color)
+{
+    uint16_t x, y;
+
+    for (y = y1; y <= y2; y++)
+    {
+        for (x = x1; x <= x2; x++)
+        {
+            st77xx_shadow[y][x] = color;
+        }
+        ST77XX_ShadowValidate(x1, y, x2 - x1 + 1);
+    }
+}
+
+//Sends rows y1..y2, columns x1..x2 of an image with `stride` pixels per row. The last
+//rectangle of a diff goes out async when its rows are contiguous, everything else blocks.
+//With `keep` the image is never packed in place.
+static void ST77XX_SendRect(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const uint16_t *src,
+                            uint16_t stride, bool keep, bool last, ST77XX_DoneCallback done, void *arg)
+{
+    uint16_t w = x2 - x1 + 1;
+    uint16_t y;
+
+    ST77XX_SetAddrWindowRaw(x1, y1, x2, y2);
+    if (w == stride && last && !(keep && st77xx_rgb444))
+    {
+        st77xx_bus->write_data_async(ST77XX_PackImage(src, w * (y2 - y1 + 1)),
+                                     ST77XX_WireBytes(w * (y2 - y1 + 1)), done, arg);
+        return;
+    }
+    if (w == stride && !st77xx_rgb444)
+    {
+        ST77XX_WriteData((const uint8_t *)src, sizeof(uint16_t) * w * (y2 - y1 + 1));
+        return;
+    }
+
+    //Pack the rows into the transmit buffer so a narrow rectangle isn't one transaction per row
+    for (y = y1; y <= y2; y++, src += stride)
+    {
+        ST77XX_WritePixels(src, w);
+    }
+    ST77XX_EndPixels();
+    if (last && done)
+        done(arg);
+}
+
+#endif
+
+//Window for the drawing calls that don't keep the shadow up to date
+static void ST77XX_SetAddrWindow(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+#if ST77XX_SHADOW_GRAM
+    ST77XX_ShadowInvalidate(x1, y1, x2, y2);
+#endif
+    ST77XX_SetAddrWindowRaw(x1, y1, x2, y2);
+}
+
+void ST77XX_BackLight_On(void)
+{
+    st77xx_bus->set_backlight(true);
+}
+
+void ST77XX_BackLight_Off(void)
+{
+    st77xx_bus->set_backlight(false);
+}
+
+#if ST77XX_FILL_BUF_SIZE % 4 || ST77XX_FILL_BUF_SIZE > ST77XX_BUS_MAX_WRITE || ST77XX_FILL_BUF_SIZE < 4 * ST77XX_WIDTH
+#error "ST77XX_FILL_BUF_SIZE must be a multiple of 4, fit one DMA segment and hold 2 rows per half"
+#endif
+
+//Fill engine. The buffer is word aligned so it can go to DMA as is, and it is only rebuilt
+//when the color or pattern changes. st77xx_fill_word is the color in both halves of a word,
+//0 with st77xx_fill_solid false means it holds a pattern.
+static uint32_t st77xx_fill_buf[ST77XX_FILL_BUF_SIZE / 4];
+static uint32_t st77xx_fill_word = 0;
+static bool st77xx_fill_solid = false;
+
+//Sends `count` times the first `size` bytes of the fill buffer. Small writes go out
+//blocking, a queued transaction costs more than their wire time.
+static void ST77XX_FillRepeat(const uint8_t *data, uint32_t size, uint32_t count)
+{
+    if (count == 0 || size == 0)
+        return;
+    if (size * count <= ST77XX_WINDOW_COST || !st77xx_bus->write_data_repeat)
+    {
+        while (count--)
+        {
+            ST77XX_WriteData(data, size);
+        }
+        return;
+    }
+    st77xx_bus->write_data_repeat(data, size, count);
+}
+
+//The buffer is about to be rewritten, whatever still reads it has to finish first
+static void ST77XX_FillClaim(void)
+{
+    st77xx_bus->wait();
+    st77xx_fill_solid = false;
+}
+
+void ST77XX_Fill(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color)
+{
+    uint32_t word = ((uint32_t)color << 16) | color;
+    uint32_t pixels = (uint32_t)(x_end - x_start) * (y_end - y_start);
+    uint32_t block = st77xx_rgb444 ? ST77XX_FILL_BUF_SIZE / 3 * 2 : ST77XX_FILL_BUF_SIZE / 2;
+    uint32_t i, pack[3];
+    uint16_t c;
+
+    //x_end and y_end are exclusive, an empty range would wrap the window and the shadow loop
+    if (x_end <= x_start || y_end <= y_start)
+        return;
+
+    if (!st77xx_fill_solid || st77xx_fill_word != word)
+    {
+        ST77XX_FillClaim();
+        if (st77xx_rgb444)
+        {
+            //4 packed pixel pairs fill 3 words
+            c = ST77XX_To444(color);
+            for (i = 0; i < 12; i++)
+            {
+                ((uint8_t *)pack)[i] = (i % 3 == 0) ? c >> 4 : (i % 3 == 1) ? (c << 4) | (c >> 8) : c;
+            }
+            for (i = 0; i < ST77XX_FILL_BUF_SIZE / 4; i++)
+            {
+                st77xx_fill_buf[i] = pack[i % 3];
+            }
+        }
+        else
+        {
+            for (i = 0; i < ST77XX_FILL_BUF_SIZE / 4; i++)
+            {
+                st77xx_fill_buf[i] = word;
+            }
+        }
+        st77xx_fill_word = word;
+        st77xx_fill_solid = true;
+    }
+
+    ST77XX_SetAddrWindowRaw(x_start, y_start, x_end - 1, y_end - 1);
+    ST77XX_FillRepeat((const uint8_t *)st77xx_fill_buf, ST77XX_FILL_BUF_SIZE, pixels / block);
+    ST77XX_FillRepeat((const uint8_t *)st77xx_fill_buf, ST77XX_WireBytes(pixels % block), 1);
+#if ST77XX_SHADOW_GRAM
+    //Done while DMA sends the pixels
+    ST77XX_ShadowFill(x_start, y_start, x_end - 1, y_end - 1, color);
+#endif
+}
+
+//Switches the wire format, the drawing calls keep taking RGB565
+void ST77XX_SetRGB444(bool enable)
+{
+    uint8_t colmod = enable ? ST77XX_COLMOD_444 : ST77XX_COLMOD_565;
+
+    ST77XX_WriteCommand(ST77XX_COLMOD);
+    ST77XX_WriteData(&colmod, 1);
+    st77xx_rgb444 = enable;
+    //The fill buffer holds pixels in the old format
+    st77xx_fill_solid = false;
+}
+
+void ST77XX_DrawPoint(uint16_t x, uint16_t y, uint16_t color)
+{
+#if ST77XX_SHADOW_GRAM
+    ST77XX_ShadowFill(x, y, x, y, color);
+    ST77XX_SetAddrWindowRaw( x, y, x, y);
+#else
+    ST77XX_SetAddrWindow( x, y, x, y);
+#endif
+    ST77XX_WritePixels(&color, 1);
+    ST77XX_EndPixels();
+}
+
+//Clips a run of pixels, x1..x2 and y1..y2 inclusive, to the screen. False if nothing is left.
+static bool ST77XX_ClipSpan(int *x1, int *y1, int *x2, int *y2)
+{
+    if (*x1 > *x2 || *y1 > *y2 || *x2 < 0 || *y2 < 0 || *x1 >= ST77XX_WIDTH || *y1 >= ST77XX_HEIGHT)
+        return false;
+    if (*x1 < 0)
+        *x1 = 0;
+    if (*y1 < 0)
+        *y1 = 0;
+    if (*x2 >= ST77XX_WIDTH)
+        *x2 = ST77XX_WIDTH - 1;
+    if (*y2 >= ST77XX_HEIGHT)
+        *y2 = ST77XX_HEIGHT - 1;
+    return true;
+}
+
+//One windowed fill for a run of pixels
+static void ST77XX_FillSpan(int x1, int y1, int x2, int y2, uint16_t color)
+{
+    if (ST77XX_ClipSpan(&x1, &y1, &x2, &y2))
+        ST77XX_Fill(x1, y1, x2 + 1, y2 + 1, color);
+}
+
+//The rasterizers below hand every run they produce to st77xx_span
+typedef void (*ST77XX_SpanFunc)(int x1, int y1, int x2, int y2, uint16_t color);
+typedef void (*ST77XX_RasterFunc)(const int *p, uint16_t color);
+
+static ST77XX_SpanFunc st77xx_span = ST77XX_FillSpan;
+
+#if ST77XX_SHADOW_GRAM
+static uint32_t st77xx_span_count;
+
+static void ST77XX_CountSpan(int x1, int y1, int x2, int y2, uint16_t color)
+{
+    st77xx_span_count++;
+}
+
+static void ST77XX_ShadowSpan(int x1, int y1, int x2, int y2, uint16_t color)
+{
+    if (ST77XX_ClipSpan(&x1, &y1, &x2, &y2))
+        ST77XX_ShadowFill(x1, y1, x2, y2, color);
+}
+#endif
+
+//Runs a rasterizer straight to the panel, one window per run. When the shadow covers the
+//bounding box and its pixels cost less than the windows of all the runs, the runs are
+//drawn into the shadow instead and the box goes out with a single window.
+static void ST77XX_Rasterize(ST77XX_RasterFunc raster, const int *p, uint16_t color, int x1, int y1, int x2, int y2)
+{
+#if ST77XX_SHADOW_GRAM
+    if (!ST77XX_ClipSpan(&x1, &y1, &x2, &y2))
+        return;
+    if (ST77XX_ShadowValid(x1, y1, x2, y2))
+    {
+        st77xx_span_count = 0;
+        st77xx_span = ST77XX_CountSpan;
+        raster(p, color);
+        if ((uint32_t)(x2 - x1 + 1) * (y2 - y1 + 1) * sizeof(uint16_t) < st77xx_span_count * ST77XX_WINDOW_COST)
+        {
+            st77xx_span = ST77XX_ShadowSpan;
+            raster(p, color);
+            st77xx_span = ST77XX_FillSpan;
+            ST77XX_SendRect(x1, y1, x2, y2, &st77xx_shadow[y1][x1], ST77XX_WIDTH, true, false, NULL, NULL);
+            return;
+        }
+        st77xx_span = ST77XX_FillSpan;
+    }
+#endif
+    raster(p, color);
+}
+
+void ST77XX_FillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    ST77XX_FillSpan(x, y, x + w - 1, y + h - 1, color);
+}
+
+//Colors are kept in wire byte order (see the ST77XX_* constants), blends color0 and color1
+//by num/den in RGB565
+static uint16_t ST77XX_Blend(uint16_t color0, uint16_t color1, uint32_t num, uint32_t den)
+{
+    uint16_t c0 = (color0 >> 8) | (color0 << 8), c1 = (color1 >> 8) | (color1 << 8);
+    int r0 = c0 >> 11, g0 = (c0 >> 5) & 0x3F, b0 = c0 & 0x1F;
+    int r1 = c1 >> 11, g1 = (c1 >> 5) & 0x3F, b1 = c1 & 0x1F;
+    uint16_t c;
+
+    if (den == 0)
+        return color0;
+    c = ((r0 + (r1 - r0) * (int)num / (int)den) << 11)
+        | ((g0 + (g1 - g0) * (int)num / (int)den) << 5)
+        | (b0 + (b1 - b0) * (int)num / (int)den);
+    return (c >> 8) | (c << 8);
+}
+
+//Repeats the first row of `buf` until `bytes` are filled, memcpy moves whole words
+static uint32_t ST77XX_FillRows(uint16_t *buf, uint16_t w, uint32_t bytes)
+{
+    uint32_t rows = bytes / (w * sizeof(uint16_t)), i;
+
+    for (i = 1; i < rows; i++)
+    {
+        memcpy(&buf[i * w], buf, w * sizeof(uint16_t));
+    }
+    return rows;
+}
+
+//Sends `rows` rows of `w` pixels from a buffer that holds `per_buf` copies of the row
+static void ST77XX_FillRowsRepeat(const uint16_t *buf, uint16_t w, uint32_t per_buf, uint32_t rows)
+{
+    if (st77xx_rgb444)
+    {
+        //Packed rows don't line up with whole bytes, they are streamed one by one
+        while (rows--)
+        {
+            ST77XX_WritePixels(buf, w);
+        }
+        return;
+    }
+    ST77XX_FillRepeat((const uint8_t *)buf, per_buf * w * sizeof(uint16_t), rows / per_buf);
+    ST77XX_FillRepeat((const uint8_t *)buf, (rows % per_buf) * w * sizeof(uint16_t), 1);
+}
+
+//Checkerboard of cell x cell squares, color0 in the top left one. Each half of the fill
+//buffer holds rows of one phase, a run of `cell` rows is sent from them without the CPU.
+void ST77XX_FillChecker(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t cell, uint16_t color0, uint16_t color1)
+{
+    uint16_t *half[2] = { (uint16_t *)st77xx_fill_buf, (uint16_t *)st77xx_fill_buf + ST77XX_FILL_BUF_SIZE / 4 };
+    int x1 = x, y1 = y, x2 = x + w - 1, y2 = y + h - 1;
+    uint32_t per_half = 0, run;
+    int i, row;
+
+    if (cell == 0 || !ST77XX_ClipSpan(&x1, &y1, &x2, &y2))
+        return;
+    w = x2 - x1 + 1;
+
+    ST77XX_FillClaim();
+    for (i = 0; i < w; i++)
+    {
+        half[0][i] = (((x1 - x + i) / cell) & 1) ? color1 : color0;
+        half[1][i] = (((x1 - x + i) / cell) & 1) ? color0 : color1;
+    }
+    per_half = ST77XX_FillRows(half[0], w, ST77XX_FILL_BUF_SIZE / 2);
+    ST77XX_FillRows(half[1], w, ST77XX_FILL_BUF_SIZE / 2);
+
+    ST77XX_SetAddrWindow(x1, y1, x2, y2);
+    for (row = y1; row <= y2; row += run)
+    {
+        run = cell - (row - y) % cell;
+        if (run > (uint32_t)(y2 - row + 1))
+            run = y2 - row + 1;
+        ST77XX_FillRowsRepeat(half[((row - y) / cell) & 1], w, per_half, run);
+    }
+    ST77XX_EndPixels();
+}
+
+//Linear gradient from color0 to color1, left to right or top to bottom. A horizontal one
+//is the same row over and over. A vertical one has a new color every row, so one half of
+//the buffer is built while the other is on the wire.
+void ST77XX_FillGradient(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color0, uint16_t color1, bool vertical)
+{
+    uint16_t *half[2] = { (uint16_t *)st77xx_fill_buf, (uint16_t *)st77xx_fill_buf + ST77XX_FILL_BUF_SIZE / 4 };
+    int x1 = x, y1 = y, x2 = x + w - 1, y2 = y + h - 1;
+    uint16_t full_w = w, color;
+    uint32_t rows, i, j;
+    int row, next = 0;
+
+    if (!ST77XX_ClipSpan(&x1, &y1, &x2, &y2))
+        return;
+    w = x2 - x1 + 1;
+
+    ST77XX_FillClaim();
+    ST77XX_SetAddrWindow(x1, y1, x2, y2);
+    if (!vertical)
+    {
+        for (i = 0; i < w; i++)
+        {
+            half[0][i] = ST77XX_Blend(color0, color1, x1 - x + i, full_w - 1);
+        }
+        rows = ST77XX_FillRows(half[0], w, ST77XX_FILL_BUF_SIZE);
+        ST77XX_FillRowsRepeat(half[0], w, rows, y2 - y1 + 1);
+        ST77XX_EndPixels();
+        return;
+    }
+
+    rows = ST77XX_FILL_BUF_SIZE / 2 / (w * sizeof(uint16_t));
+    for (row = y1; row <= y2; row += rows, next ^= 1)
+    {
+        if (rows > (uint32_t)(y2 - row + 1))
+            rows = y2 - row + 1;
+        for (i = 0; i < rows; i++)
+        {
+            color = ST77XX_Blend(color0, color1, row - y + i, h - 1);
+            for (j = 0; j < w; j++)
+            {
+                half[next][i * w + j] = color;
+            }
+        }
+        if (st77xx_rgb444)
+        {
+            ST77XX_WritePixels(half[next], rows * w);
+            continue;
+        }
+        //The other half was queued last time round, this one is free again once it is out
+        st77xx_bus->wait();
+        ST77XX_FillRepeat((const uint8_t *)half[next], rows * w * sizeof(uint16_t), 1);
+    }
+    ST77XX_EndPixels();
+}
+
+//Bresenham, but every run of pixels on the same row (or column for steep lines) is
+//sent as one fill instead of pixel by pixel. p: x_start, y_start, x_end, y_end
+static void ST77XX_RasterLine(const int *p, uint16_t color)
+{
+    int x_end = p[2], y_end = p[3];
+    int dx = abs(x_end - p[0]), dy = abs(y_end - p[1]);
+    int sx = p[0] < x_end ? 1 : -1, sy = p[1] < y_end ? 1 : -1;
+    int x = p[0], y = p[1], start, err;
+
+    if (dx >= dy)
+    {
+        //水平方向为主, 每行一段
+        err = 2 * dy - dx;
+        start = x;
+        while (x != x_end)
+        {
+            if (err > 0)
+            {
+                st77xx_span(start < x ? start : x, y, start < x ? x : start, y, color);
+                y += sy;
+                err -= 2 * dx;
+                start = x + sx;
+            }
+            err += 2 * dy;
+            x += sx;
+        }
+        st77xx_span(start < x ? start : x, y, start < x ? x : start, y, color);
+    }
+    else
+    {
+        //垂直方向为主, 每列一段
+        err = 2 * dx - dy;
+        start = y;
+        while (y != y_end)
+        {
+            if (err > 0)
+            {
+                st77xx_span(x, start < y ? start : y, x, start < y ? y : start, color);
+                x += sx;
+                err -= 2 * dy;
+                start = y + sy;
+            }
+            err += 2 * dx;
+            y += sy;
+        }
+        st77xx_span(x, start < y ? start : y, x, start < y ? y : start, color);
+    }
+}
+
+void ST77XX_DrawLine(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color)
+{
+    int p[] = { x_start, y_start, x_end, y_end };
+
+    ST77XX_Rasterize(ST77XX_RasterLine, p, color,
+                     x_start < x_end ? x_start : x_end, y_start < y_end ? y_start : y_end,
+                     x_start < x_end ? x_end : x_start, y_start < y_end ? y_end : y_start);
+}
+
+void ST77XX_DrawRectangle(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color)
+{
+    int x1 = x_start < x_end ? x_start : x_end, x2 = x_start < x_end ? x_end : x_start;
+    int y1 = y_start < y_end ? y_start : y_end, y2 = y_start < y_end ? y_end : y_start;
+
+    //Top and bottom share the columns, left and right share the rows, so the second
+    //edge of each pair only needs half a window
+    ST77XX_FillSpan(x1, y1, x2, y1, color);
+    ST77XX_FillSpan(x1, y2, x2, y2, color);
+    ST77XX_FillSpan(x1, y1, x1, y2, color);
+    ST77XX_FillSpan(x2, y1, x2, y2, color);
+}
+
+//Midpoint circle stepped one octant at a time. Consecutive steps with the same b form a
+//run a0..a1 that is mirrored into 4 horizontal and 4 vertical spans. p: x, y, radius
+static void ST77XX_RasterCircle(const int *p, uint16_t color)
+{
+    int cx = p[0], cy = p[1], radius = p[2];
+    int a = 0, b = radius, a0, a1, cb;
+
+    while (a <= b)
+    {
+        a0 = a;
+        cb = b;
+        do
+        {
+            a++;
+            if ((a * a + b * b) > (radius * radius))
+            {
+                b--;
+            }
+        } while (a <= b && b == cb);
+        a1 = a - 1;
+
+        if (a0 == 0)
+        {
+            st77xx_span(cx - a1, cy - cb, cx + a1, cy - cb, color);
+            st77xx_span(cx - a1, cy + cb, cx + a1, cy + cb, color);
+            st77xx_span(cx - cb, cy - a1, cx - cb, cy + a1, color);
+            st77xx_span(cx + cb, cy - a1, cx + cb, cy + a1, color);
+        }
+        else
+        {
+            st77xx_span(cx - a1, cy - cb, cx - a0, cy - cb, color);
+            st77xx_span(cx + a0, cy - cb, cx + a1, cy - cb, color);
+            st77xx_span(cx - a1, cy + cb, cx - a0, cy + cb, color);
+            st77xx_span(cx + a0, cy + cb, cx + a1, cy + cb, color);
+            st77xx_span(cx - cb, cy - a1, cx - cb, cy - a0, color);
+            st77xx_span(cx - cb, cy + a0, cx - cb, cy + a1, color);
+            st77xx_span(cx + cb, cy - a1, cx + cb, cy - a0, color);
+            st77xx_span(cx + cb, cy + a0, cx + cb, cy + a1, color);
+        }
+    }
+}
+
+//Same stepping as the outline. Each run gives a block of rows -a1..-a0 and a0..a1 that
+//are 2*b+1 wide, plus the rows at +-b that are 2*a1+1 wide.
+static void ST77XX_RasterFilledCircle(const int *p, uint16_t color)
+{
+    int cx = p[0], cy = p[1], radius = p[2];
+    int a = 0, b = radius, a0, a1, cb;
+
+    while (a <= b)
+    {
+        a0 = a;
+        cb = b;
+        do
+        {
+            a++;
+            if ((a * a + b * b) > (radius * radius))
+            {
+                b--;
+            }
+        } while (a <= b && b == cb);
+        a1 = a - 1;
+
+        if (a0 == 0)
+        {
+            st77xx_span(cx - cb, cy - a1, cx + cb, cy + a1, color);
+        }
+        else
+        {
+            st77xx_span(cx - cb, cy - a1, cx + cb, cy - a0, color);
+            st77xx_span(cx - cb, cy + a0, cx + cb, cy + a1, color);
+        }
+        if (cb > a1)
+        {
+            st77xx_span(cx - a1, cy - cb, cx + a1, cy - cb, color);
+            st77xx_span(cx - a1, cy + cb, cx + a1, cy + cb, color);
+        }
+    }
+}
+
+void ST77XX_DrawCircle(uint16_t x, uint16_t y, uint8_t radius, uint16_t color)
+{
+    int p[] = { x, y, radius };
+
+    ST77XX_Rasterize(ST77XX_RasterCircle, p, color, x - radius, y - radius, x + radius, y + radius);
+}
+
+void ST77XX_FillCircle(uint16_t x, uint16_t y, uint8_t radius, uint16_t color)
+{
+    int p[] = { x, y, radius };
+
+    ST77XX_Rasterize(ST77XX_RasterFilledCircle, p, color, x - radius, y - radius, x + radius, y + radius);
+}
+
+void ST77XX_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *data)
+{
+    if ((x >= ST77XX_WIDTH) || (y >= ST77XX_HEIGHT))
+        return;
+    if ((x + w - 1) >= ST77XX_WIDTH)
+        return;
+    if ((y + h - 1) >= ST77XX_HEIGHT)
+        return;
+
+    ST77XX_SetAddrWindow(x, y, x + w - 1, y + h - 1);
+    if (st77xx_rgb444)
+    {
+        ST77XX_WritePixels(data, (uint32_t)w * h);
+        ST77XX_EndPixels();
+        return;
+    }
+    ST77XX_WriteData((uint8_t *)data, sizeof(uint16_t) * w * h);
+}
+
+void ST77XX_DrawFrame(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *frame)
+{
+    uint16_t r;
+
+    if ((x >= ST77XX_WIDTH) || (y >= ST77XX_HEIGHT)
+        || ((x + w - 1) >= ST77XX_WIDTH) || ((y + h - 1) >= ST77XX_HEIGHT))
+        return;
+
+    ST77XX_SetAddrWindow(x, y, x + w - 1, y + h - 1);
+    frame += y * ST77XX_WIDTH + x;
+    for (r = 0; r < h; r++, frame += ST77XX_WIDTH)
+    {
+        ST77XX_WritePixels(frame, w);
+    }
+    ST77XX_EndPixels();
+}
+
+void ST77XX_DrawImageAsync(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *data, ST77XX_DoneCallback done, void *arg)
+{
+    if ((x >= ST77XX_WIDTH) || (y >= ST77XX_HEIGHT)
+        || ((x + w - 1) >= ST77XX_WIDTH) || ((y + h - 1) >= ST77XX_HEIGHT))
+    {
+        if (done)
+            done(arg);
+        return;
+    }
+
+    // The bus waits for the previous async write before the window is set
+    ST77XX_SetAddrWindow(x, y, x + w - 1, y + h - 1);
+    st77xx_bus->write_data_async(ST77XX_PackImage(data, (uint32_t)w * h), ST77XX_WireBytes((uint32_t)w * h), done, arg);
+}
+
+#if ST77XX_SHADOW_GRAM
+//Compares one row of the image with the shadow and copies it over. Returns the number of
+//changed spans, spans closer than the cost of a window setup are merged.
+static uint16_t ST77XX_DiffRow(const uint16_t *src, uint16_t x, uint16_t y, uint16_t w)
+{
+    uint16_t *shadow = &st77xx_shadow[y][x];
+    uint16_t inv1 = st77xx_inv_x1[y], inv2 = st77xx_inv_x2[y];
+    uint16_t n = 0, i, start;
+
+    for (i = 0; i < w; i++)
+    {
+        if (src[i] == shadow[i] && (x + i < inv1 || x + i > inv2))
+            continue;
+
+        start = i;
+        while (i < w && (src[i] != shadow[i] || (x + i >= inv1 && x + i <= inv2)))
+        {
+            shadow[i] = src[i];
+            i++;
+        }
+        if (n > 0 && (x + start - st77xx_spans[n - 1].x2 - 1) * sizeof(uint16_t) < ST77XX_WINDOW_COST)
+        {
+            st77xx_spans[n - 1].x2 = x + i - 1;
+        }
+        else
+        {
+            st77xx_spans[n].x1 = x + start;
+            st77xx_spans[n].x2 = x + i - 1;
+            n++;
+        }
+    }
+
+    ST77XX_ShadowValidate(x, y, w);
+    return n;
+}
+
+//Diff of an image with `stride` pixels per row against the shadow, see ST77XX_SendRect for `keep`
+static void ST77XX_Diff(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *data,
+                        uint16_t stride, bool keep, ST77XX_DoneCallback done, void *arg)
+{
+    //Pending rectangle, rows with the same single span are sent with one window
+    uint16_t rx1 = 0, rx2 = 0, ry1 = 0, ry2 = 0;
+    const uint16_t *rsrc = NULL;
+    bool pending = false;
+    uint16_t r, n, i;
+
+    if ((x >= ST77XX_WIDTH) || (y >= ST77XX_HEIGHT)
+        || ((x + w - 1) >= ST77XX_WIDTH) || ((y + h - 1) >= ST77XX_HEIGHT))
+    {
+        if (done)
+            done(arg);
+        return;
+    }
+
+    for (r = 0; r < h; r++)
+    {
+        const uint16_t *src = data + r * stride;
+        n = ST77XX_DiffRow(src, x, y + r, w);
+
+        if (pending && n == 1 && st77xx_spans[0].x1 == rx1 && st77xx_spans[0].x2 == rx2 && ry2 == y + r - 1)
+        {
+            ry2++;
+            continue;
+        }
+        if (pending)
+        {
+            ST77XX_SendRect(rx1, ry1, rx2, ry2, rsrc, stride, keep, false, NULL, NULL);
+            pending = false;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (i == n - 1)
+            {
+                //Keep the last span open, the next rows may extend it
+                rx1 = st77xx_spans[i].x1;
+                rx2 = st77xx_spans[i].x2;
+                ry1 = ry2 = y + r;
+                rsrc = src + (rx1 - x);
+                pending = true;
+            }
+            else
+            {
+                ST77XX_SendRect(st77xx_spans[i].x1, y + r, st77xx_spans[i].x2, y + r,
+                                src + (st77xx_spans[i].x1 - x), stride, keep, false, NULL, NULL);
+            }
+        }
+    }
+
+    if (pending)
+        ST77XX_SendRect(rx1, ry1, rx2, ry2, rsrc, stride, keep, true, done, arg);
+    else if (done)
+        done(arg);
+}
+
+void ST77XX_DrawImageDiff(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *data, ST77XX_DoneCallback done, void *arg)
+{
+    ST77XX_Diff(x, y, w, h, data, w, false, done, arg);
+}
+
+void ST77XX_DrawFrameDiff(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *frame, ST77XX_DoneCallback done, void *arg)
+{
+    ST77XX_Diff(x, y, w, h, frame + y * ST77XX_WIDTH + x, ST77XX_WIDTH, true, done, arg);
+}
+#endif
+
+//Glyph blitter. st77xx_glyph_lut[n] holds the 4 pixels of nibble n, first pixel in bit 3,
+//as two words to store straight into the transmit buffer (little endian, so the first
+//pixel of a word is its low half). Rebuilt only when the colors change.
+static uint32_t st77xx_glyph_lut[16][2];
+static uint16_t st77xx_glyph_fg, st77xx_glyph_bg;
+static bool st77xx_glyph_lut_valid = false;
+
+//A row of text in RGB565, on its way to be packed in RGB444 mode
+static uint16_t st77xx_row[ST77XX_WIDTH + 4] __attribute__((aligned(4)));
+
+//Bit reversed nibbles, for the fonts stored LSB first
+static const uint8_t st77xx_rev4[16] = {
+    0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+};
+
+static void ST77XX_GlyphColors(uint16_t color, uint16_t bgcolor)
+{
+    uint8_t n;
+
+    if (st77xx_glyph_lut_valid && st77xx_glyph_fg == color && st77xx_glyph_bg == bgcolor)
+        return;
+    for (n = 0; n < 16; n++)
+    {
+        st77xx_glyph_lut[n][0] = ((n & 0x8) ? color : bgcolor) | (uint32_t)((n & 0x4) ? color : bgcolor) << 16;
+        st77xx_glyph_lut[n][1] = ((n & 0x2) ? color : bgcolor) | (uint32_t)((n & 0x1) ? color : bgcolor) << 16;
+    }
+    st77xx_glyph_fg = color;
+    st77xx_glyph_bg = bgcolor;
+    st77xx_glyph_lut_valid = true;
+}
+
+//Expands one glyph row of `width` pixels into `dst`. Whole nibbles are stored, so up to 3
+//pixels past the row get written too, the next row starts on top of them. A row starting
+//on an odd pixel is stored as halfword, word, halfword.
+static void ST77XX_GlyphRow(uint8_t *dst, const uint8_t *src, uint8_t width, uint8_t order)
+{
+    uint8_t i, b, n;
+
+    for (i = 0; i < width; i += 4, dst += 8)
+    {
+        b = src[i >> 3];
+        if (order == 0)
+            n = (i & 4) ? (b & 0x0F) : (b >> 4);
+        else
+            n = (i & 4) ? st77xx_rev4[b >> 4] : st77xx_rev4[b & 0x0F];
+
+        if (((uintptr_t)dst & 2) == 0)
+        {
+            ((uint32_t *)dst)[0] = st77xx_glyph_lut[n][0];
+            ((uint32_t *)dst)[1] = st77xx_glyph_lut[n][1];
+        }
+        else
+        {
+            *(uint16_t *)dst = (n & 0x8) ? st77xx_glyph_fg : st77xx_glyph_bg;
+            *(uint32_t *)(dst + 2) = st77xx_glyph_lut[(n << 1) & 0xC][0];
+            *(uint16_t *)(dst + 6) = (n & 0x1) ? st77xx_glyph_fg : st77xx_glyph_bg;
+        }
+    }
+}
+
+#if ST77XX_GLYPH_CACHE
+//Glyph cache. Slots of a fixed arena hold glyphs expanded with the table above, so a hit
+//is sent as it is. `used` orders the slots for LRU eviction, 0 is a free slot. Slots
+//looked up during the current draw call carry its number in `pin` and are not evicted
+//while the call still needs them.
+typedef struct {
+    const FontDef_t *font;
+    uint16_t fg;
+    uint16_t bg;
+    char ch;
+    uint32_t used;
+    uint32_t pin;
+} ST77XX_GlyphSlot_t;
+
+static uint32_t st77xx_gcache[ST77XX_GLYPH_SLOTS][ST77XX_GLYPH_SLOT_SIZE / 4];
+static ST77XX_GlyphSlot_t st77xx_gslot[ST77XX_GLYPH_SLOTS];
+static uint32_t st77xx_gcache_clock = 0;
+static uint32_t st77xx_gcache_call = 0;
+static ST77XX_GlyphStats_t st77xx_gstats;
+
+void ST77XX_GetGlyphStats(ST77XX_GlyphStats_t *stats)
+{
+    *stats = st77xx_gstats;
+}
+
+void ST77XX_ResetGlyphStats(void)
+{
+    memset(&st77xx_gstats, 0, sizeof(st77xx_gstats));
+}
+
+//Rendered glyph, NULL if it has to be drawn without the cache
+static const uint8_t *ST77XX_GlyphCached(FontDef_t *font, char ch, uint16_t color, uint16_t bgcolor)
+{
+    uint8_t bytes = font->width / 8 + ((font->width % 8)? 1 : 0);
+    uint16_t row = font->width * sizeof(uint16_t), i;
+    const uint8_t *src;
+    uint8_t *dst;
+    int s, victim = -1;
+
+    if (row * font->height + 8 > ST77XX_GLYPH_SLOT_SIZE)
+    {
+        st77xx_gstats.bypass++;
+        return NULL;
+    }
+    st77xx_gcache_clock++;
+    for (s = 0; s < ST77XX_GLYPH_SLOTS; s++)
+    {
+        ST77XX_GlyphSlot_t *slot = &st77xx_gslot[s];
+        if (slot->used && slot->font == font && slot->ch == ch && slot->fg == color && slot->bg == bgcolor)
+        {
+            slot->used = st77xx_gcache_clock;
+            slot->pin = st77xx_gcache_call;
+            st77xx_gstats.hits++;
+            return (const uint8_t *)st77xx_gcache[s];
+        }
+        if (slot->pin != st77xx_gcache_call && (victim < 0 || slot->used < st77xx_gslot[victim].used))
+        {
+            victim = s;
+        }
+    }
+    if (victim < 0)
+    {
+        st77xx_gstats.bypass++;
+        return NULL;
+    }
+
+    st77xx_gstats.misses++;
+    if (st77xx_gslot[victim].used)
+        st77xx_gstats.evictions++;
+    //An async write may still be sending the old glyph
+    st77xx_bus->wait();
+    ST77XX_GlyphColors(color, bgcolor);
+    dst = (uint8_t *)st77xx_gcache[victim];
+    src = &font->data[(ch - 32) * font->height * bytes];
+    for (i = 0; i < font->height; i++, src += bytes, dst += row)
+    {
+        ST77XX_GlyphRow(dst, src, font->width, font->order);
+    }
+    st77xx_gslot[victim] = (ST77XX_GlyphSlot_t){ font, color, bgcolor, ch, st77xx_gcache_clock, st77xx_gcache_call };
+    return (const uint8_t *)st77xx_gcache[victim];
+}
+#endif
+
+//Lays `len` characters out in one window over their bounding box, clipped to the screen,
+//and streams it row by row across all the glyphs. Glyphs come from the cache when all of
+//them fit in it, a single whole glyph is then sent straight from its slot.
+static void ST77XX_DrawText(uint16_t x, uint16_t y, const char *p, uint16_t len, FontDef_t *font, uint16_t color, uint16_t bgcolor)
+{
+    uint8_t bytes = font->width / 8 + ((font->width % 8)? 1 : 0);
+    uint16_t w, h, i, c, n = 0;
+    const uint8_t *src;
+    uint8_t *dst;
+#if ST77XX_GLYPH_CACHE
+    const uint8_t *glyph[ST77XX_GLYPH_SLOTS];
+    bool cached = false;
+#endif
+
+    if (len == 0 || x >= ST77XX_WIDTH || y >= ST77XX_HEIGHT)
+        return;
+    w = (uint32_t)len * font->width > ST77XX_WIDTH - x ? ST77XX_WIDTH - x : len * font->width;
+    h = font->height > ST77XX_HEIGHT - y ? ST77XX_HEIGHT - y : font->height;
+    //Characters that are at least partly on screen
+    len = (w + font->width - 1) / font->width;
+
+#if ST77XX_GLYPH_CACHE
+    if (len <= ST77XX_GLYPH_SLOTS)
+    {
+        st77xx_gcache_call++;
+        for (c = 0; c < len; c++)
+        {
+            glyph[c] = ST77XX_GlyphCached(font, p[c], color, bgcolor);
+            if (!glyph[c])
+                break;
+        }
+        cached = (c == len);
+    }
+    if (cached && len == 1 && w == font->width && h == font->height && !st77xx_rgb444)
+    {
+        ST77XX_SetAddrWindow(x, y, x + w - 1, y + h - 1);
+        st77xx_bus->write_data_async(glyph[0], w * h * sizeof(uint16_t), NULL, NULL);
+        return;
+    }
+#endif
+
+    ST77XX_SetAddrWindow(x, y, x + w - 1, y + h - 1);
+    ST77XX_GlyphColors(color, bgcolor);
+
+    for (i = 0; i < h; i++)
+    {
+        //the expansion of the last glyph may reach up to 3 pixels further
+        if (!st77xx_rgb444 && st77xx_buf_pt + w * sizeof(uint16_t) + 8 > ST77XX_BUF_SIZE)
+        {
+            ST77XX_FlushBuff();
+        }
+        dst = st77xx_rgb444 ? (uint8_t *)st77xx_row : &st77xx_buf[st77xx_buf_pt];
+        for (c = 0; c < len; c++, dst += n * sizeof(uint16_t))
+        {
+            n = w - c * font->width < font->width ? w - c * font->width : font->width;
+#if ST77XX_GLYPH_CACHE
+            if (cached)
+            {
+                memcpy(dst, glyph[c] + i * font->width * sizeof(uint16_t), n * sizeof(uint16_t));
+                continue;
+            }
+#endif
+            src = &font->data[((p[c] - 32) * font->height + i) * bytes];
+            ST77XX_GlyphRow(dst, src, n, font->order);
+        }
+        if (st77xx_rgb444)
+            ST77XX_WritePixels(st77xx_row, w);
+        else
+            st77xx_buf_pt += w * sizeof(uint16_t);
+    }
+    ST77XX_EndPixels();
+}
+
+void ST77XX_DrawChar(uint16_t x, uint16_t y, char ch, FontDef_t* font, uint16_t color, uint16_t bgcolor)
+{
+    ST77XX_DrawText(x, y, &ch, 1, font, color, bgcolor);
+}
+
+void ST77XX_DrawString(uint16_t x, uint16_t y, const char *p, FontDef_t* font, uint16_t color, uint16_t bgcolor)
+{
+    ST77XX_DrawText(x, y, p, strlen(p), font, color, bgcolor);
+}
+
+//Redraws the characters of `p` that differ from `old`, the string drawn at the same place
+//before. Each run of changed characters is one window, a clock that ticks a second sends
+//one glyph.
+void ST77XX_UpdateString(uint16_t x, uint16_t y, const char *old, const char *p, FontDef_t* font, uint16_t color, uint16_t bgcolor)
+{
+    uint16_t old_len = strlen(old), i = 0, start;
+
+    while (p[i] != '\0')
+    {
+        if (i < old_len && old[i] == p[i])
+        {
+            i++;
+            continue;
+        }
+        start = i;
+        while (p[i] != '\0' && (i >= old_len || old[i] != p[i]))
+        {
+            i++;
+        }
+        ST77XX_DrawText(x + start * font->width, y, &p[start], i - start, font, color, bgcolor);
+    }
+}
@@ -14,11 +14,31 @@
 #ifndef __ST77XX_H_
 #define __ST77XX_H_
 
-#include "driver/gpio.h"
+#include <stdbool.h>
 #include "ascii_fonts.h"
+#include "st77xx_bus.h"
 
 #define ST77XX_BUF_SIZE         1024
-#define ST77XX_HARDWARE_SPI     1
+// Pixel format on the wire, 0: RGB565 (COLMOD 0x05), 1: RGB444 (COLMOD 0x03), 1.5 instead
+// of 2 bytes per pixel. The drawing calls take RGB565 either way, see ST77XX_SetRGB444.
+#define ST77XX_RGB444           0
+// Line buffer of the fill engine, built once per color or pattern and sent over and over
+// by DMA. 12 rows of 160, 15 of 128 or 8 of 240 pixels, and it fits one DMA segment.
+#define ST77XX_FILL_BUF_SIZE    3840
+// Cache of rendered glyphs, ready to send. ST77XX_GLYPH_SLOTS glyphs of up to
+// ST77XX_GLYPH_SLOT_SIZE bytes (minus 8 bytes of slack) each, bigger ones are not cached.
+// 512 bytes hold every font up to 11x18.
+#define ST77XX_GLYPH_CACHE      1
+#define ST77XX_GLYPH_SLOTS      16
+#define ST77XX_GLYPH_SLOT_SIZE  512
+
+// Keep a copy of the panel contents (WIDTH*HEIGHT*2 bytes) so ST77XX_DrawImageDiff only
+// sends the pixels that changed
+#define ST77XX_SHADOW_GRAM      1
+// Bytes a window setup costs on the wire, transaction overhead included: up to five
+// polling transactions of ~5 us each, at 40 MHz that is the time of ~128 bytes.
+// Changed spans of a row closer than this are sent as one.
+#define ST77XX_WINDOW_COST      128
 
 #define ST77XX_CS_PIN       7
 #define ST77XX_SCK_PIN      2
@@ -28,28 +48,6 @@
 #define ST77XX_DC_PIN       6
 #define ST77XX_BL_PIN       11
 
-#define GPIO_PIN_RESET 0
-#define GPIO_PIN_SET 1
-
-#if ST77XX_HARDWARE_SPI
-    #define ST77XX_CS_LOW       
-    #define ST77XX_CS_HIGH      
-#else
-    #define ST77XX_SCK_LOW      gpio_set_level(ST77XX_SCK_PIN, GPIO_PIN_RESET)
-    #define ST77XX_SCK_HIGH     gpio_set_level(ST77XX_SCK_PIN, GPIO_PIN_SET)
-    #define ST77XX_CS_LOW       gpio_set_level(ST77XX_CS_PIN, GPIO_PIN_RESET)
-    #define ST77XX_CS_HIGH      gpio_set_level(ST77XX_CS_PIN, GPIO_PIN_SET)
-    #define ST77XX_MOSI_LOW     gpio_set_level(ST77XX_MOSI_PIN, GPIO_PIN_RESET)
-    #define ST77XX_MOSI_HIGH    gpio_set_level(ST77XX_MOSI_PIN, GPIO_PIN_SET)
-#endif
-
-#define ST77XX_BL_LOW           gpio_set_level(ST77XX_BL_PIN, GPIO_PIN_RESET)
-#define ST77XX_BL_HIGH          gpio_set_level(ST77XX_BL_PIN, GPIO_PIN_SET)
-#define ST77XX_DC_LOW           gpio_set_level(ST77XX_DC_PIN, GPIO_PIN_RESET)
-#define ST77XX_DC_HIGH          gpio_set_level(ST77XX_DC_PIN, GPIO_PIN_SET)
-#define ST77XX_RESET_LOW        gpio_set_level(ST77XX_RES_PIN, GPIO_PIN_RESET)
-#define ST77XX_RESET_HIGH       gpio_set_level(ST77XX_RES_PIN, GPIO_PIN_SET)
-
 // ST7789V-based 2.4" display, default orientation
 /*
 #define ST77XX_WIDTH  240
@@ -157,6 +155,8 @@
 #define ST77XX_TEON      0x35
 #define ST77XX_MADCTL    0x36
 #define ST77XX_COLMOD    0x3A
+#define ST77XX_COLMOD_444   0x03
+#define ST77XX_COLMOD_565   0x05
 
 #define ST77XX_MADCTL_MY 0x80
 #define ST77XX_MADCTL_MX 0x40
@@ -183,7 +183,24 @@
 #define ST77XX_ORANGE    0x00FC
 #define ST77XX_BROWN     0X40BC
 
-void ST77XX_Init(void);
+#if ST77XX_GLYPH_CACHE
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t bypass;        // glyphs drawn without the cache, too big or no free slot
+} ST77XX_GlyphStats_t;
+#endif
+
+//Command lists run a few commands at a time, the caller waits between the steps
+typedef struct {
+    const uint8_t *const *lists;    // NULL terminated, NULL once all of them ran
+    const uint8_t *addr;            // next command of *lists
+    uint8_t commands;               // commands left in *lists
+    uint8_t reset;                  // 2 reset pulse pending, 1 reset line to release
+} ST77XX_Seq_t;
+
+void ST77XX_Init(const ST77XX_Bus_t *bus);
 void ST77XX_Reset(void);
 void ST77XX_BackLight_On(void);
 void ST77XX_BackLight_Off(void);
@@ -191,10 +208,38 @@ void ST77XX_DrawPoint(uint16_t x, uint16_t y, uint16_t color);
 void ST77XX_DrawLine(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color);
 void ST77XX_DrawRectangle(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color);
 void ST77XX_DrawCircle(uint16_t x, uint16_t y, uint8_t radius, uint16_t color);
+void ST77XX_FillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
+void ST77XX_FillCircle(uint16_t x, uint16_t y, uint8_t radius, uint16_t color);
+void ST77XX_FillChecker(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t cell, uint16_t color0, uint16_t color1);
+void ST77XX_FillGradient(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color0, uint16_t color1, bool vertical);
 void ST77XX_DrawChar(uint16_t x, uint16_t y, const char ch, FontDef_t* font, uint16_t color, uint16_t bgcolor);
 void ST77XX_DrawString(uint16_t x, uint16_t y, const char *p, FontDef_t* font, uint16_t color, uint16_t bgcolor);
+void ST77XX_UpdateString(uint16_t x, uint16_t y, const char *old, const char *p, FontDef_t* font, uint16_t color, uint16_t bgcolor);
 void ST77XX_DrawImage(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t* data);
+// In RGB444 mode these two pack `data` in place, it holds garbage once `done` is called
+void ST77XX_DrawImageAsync(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t* data, ST77XX_DoneCallback done, void *arg);
+// Area of a screen sized image, ST77XX_WIDTH pixels per row. These only read `frame`, in
+// RGB444 mode too, so it can be a frame buffer LVGL keeps drawing into.
+void ST77XX_DrawFrame(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *frame);
+#if ST77XX_SHADOW_GRAM
+void ST77XX_DrawImageDiff(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t* data, ST77XX_DoneCallback done, void *arg);
+void ST77XX_DrawFrameDiff(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *frame, ST77XX_DoneCallback done, void *arg);
+#endif
+void ST77XX_WaitAsync(void);
+void ST77XX_SetWindowBatching(bool enable);
+void ST77XX_SetRGB444(bool enable);
+void ST77XX_GetStats(ST77XX_Stats_t *stats);
+void ST77XX_ResetStats(void);
+#if ST77XX_GLYPH_CACHE
+void ST77XX_GetGlyphStats(ST77XX_GlyphStats_t *stats);
+void ST77XX_ResetGlyphStats(void);
+#endif
 void ST77XX_ExecuteCommandList(const uint8_t *addr);
+//Runs `lists` one after the other, after a reset pulse if `reset`. ST77XX_SeqStep sends
+//commands up to the next one with a delay and returns the delay in ms, -1 once all are sent.
+void ST77XX_SeqStart(ST77XX_Seq_t *seq, const uint8_t *const *lists, bool reset);
+int ST77XX_SeqStep(ST77XX_Seq_t *seq);
+//x_end and y_end are exclusive, an empty range draws nothing
 void ST77XX_Fill(uint16_t x_start, uint16_t y_start, uint16_t x_end, uint16_t y_end, uint16_t color);
 
 #endif // __ST77XX_H_
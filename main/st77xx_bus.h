@@ -0,0 +1,55 @@
+/******************************************************************************
+**
+ * \file        st77xx_bus.h
+ * \brief       Transport layer of the ST77XX driver
+ * \note        st77xx.c only talks to the panel through one of these, so the
+ *              same drawing code runs on the ESP SPI bus and on a host
+ *              emulator.
+ *
+******************************************************************************/
+
+#ifndef __ST77XX_BUS_H_
+#define __ST77XX_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Called once an async write has left the buffer it was given, may run in irq context
+typedef void (*ST77XX_DoneCallback)(void *arg);
+
+// Bus traffic counters, for benchmarks
+typedef struct {
+    uint32_t transactions;  // bus transactions, commands and data
+    uint32_t bytes;         // bytes on the wire
+    uint32_t windows;       // address windows set
+    uint32_t dc_toggles;    // changes of the D/C line
+} ST77XX_Stats_t;
+
+// Largest blocking data write, one DMA segment of the ESP transport
+#define ST77XX_BUS_MAX_WRITE 4092
+
+typedef struct {
+    void (*init)(void);
+    // Blocking writes, a command byte with D/C low and data with D/C high, at most
+    // ST77XX_BUS_MAX_WRITE bytes of it
+    void (*write_command)(uint8_t cmd);
+    void (*write_data)(const uint8_t *data, uint32_t size);
+    // Queues data bytes of any size, `done(arg)` is called once the last of them is out.
+    // `data` must stay untouched until then.
+    void (*write_data_async)(const uint8_t *data, uint32_t size, ST77XX_DoneCallback done, void *arg);
+    // Optional, queues `count` copies of the same `size` bytes (at most ST77XX_BUS_MAX_WRITE) back to back.
+    // `data` must stay untouched until `wait` returns.
+    void (*write_data_repeat)(const uint8_t *data, uint32_t size, uint32_t count);
+    // Optional, CASET (if `caset`), RASET (if `raset`) and RAMWR in one go
+    void (*write_window)(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, bool caset, bool raset);
+    // Blocks until every async write is done
+    void (*wait)(void);
+    void (*set_reset)(bool level);
+    void (*set_backlight)(bool on);
+    void (*delay_ms)(uint32_t ms);
+} ST77XX_Bus_t;
+
+// Updated by the bus backends
+extern ST77XX_Stats_t st77xx_stats;
+
+#endif // __ST77XX_BUS_H_
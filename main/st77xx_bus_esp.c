@@ -0,0 +1,396 @@
+/******************************************************************************
+**
+ * \file        st77xx_bus_esp.c
+ * \brief       ESP32 SPI transport of the ST77XX driver
+ * \note        Pins are set in st77xx.h
+ *
+ *              ST77XX_HARDWARE_SPI - 0: Software SPI, 1: Hardware SPI
+ *
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "st77xx.h"
+#include "st77xx_bus_esp.h"
+
+#define ST77XX_HARDWARE_SPI     1
+
+#define GPIO_PIN_RESET 0
+#define GPIO_PIN_SET 1
+
+#if ST77XX_HARDWARE_SPI
+    #define ST77XX_CS_LOW
+    #define ST77XX_CS_HIGH
+#else
+    #define ST77XX_SCK_LOW      gpio_set_level(ST77XX_SCK_PIN, GPIO_PIN_RESET)
+    #define ST77XX_SCK_HIGH     gpio_set_level(ST77XX_SCK_PIN, GPIO_PIN_SET)
+    #define ST77XX_CS_LOW       gpio_set_level(ST77XX_CS_PIN, GPIO_PIN_RESET)
+    #define ST77XX_CS_HIGH      gpio_set_level(ST77XX_CS_PIN, GPIO_PIN_SET)
+    #define ST77XX_MOSI_LOW     gpio_set_level(ST77XX_MOSI_PIN, GPIO_PIN_RESET)
+    #define ST77XX_MOSI_HIGH    gpio_set_level(ST77XX_MOSI_PIN, GPIO_PIN_SET)
+#endif
+
+#define ST77XX_BL_LOW           gpio_set_level(ST77XX_BL_PIN, GPIO_PIN_RESET)
+#define ST77XX_BL_HIGH          gpio_set_level(ST77XX_BL_PIN, GPIO_PIN_SET)
+#define ST77XX_DC_LOW           gpio_set_level(ST77XX_DC_PIN, GPIO_PIN_RESET)
+#define ST77XX_DC_HIGH          gpio_set_level(ST77XX_DC_PIN, GPIO_PIN_SET)
+#define ST77XX_RESET_LOW        gpio_set_level(ST77XX_RES_PIN, GPIO_PIN_RESET)
+#define ST77XX_RESET_HIGH       gpio_set_level(ST77XX_RES_PIN, GPIO_PIN_SET)
+
+#define LCD_HOST    SPI2_HOST
+
+//Largest single DMA transfer. Bigger writes are split into segments of this size, it is
+//one DMA descriptor worth of data and a multiple of both 2 and 4 bytes.
+#define ST77XX_DMA_SEG_SIZE     ST77XX_BUS_MAX_WRITE
+//Number of segments that can be queued on the SPI driver at once. With 4092 byte segments
+//10 of them cover a whole 160x128 frame.
+#define ST77XX_QUEUE_SIZE       10
+
+//Bits of spi_transaction_t.user
+#define ST77XX_TRANS_DC         0x01    // level of the D/C line during the transfer
+#define ST77XX_TRANS_LAST       0x02    // last segment of an async write, fire the done callback
+
+static int st77xx_last_dc = -1;
+
+static void ST77XX_CountTrans(int dc, uint32_t size)
+{
+    st77xx_stats.transactions++;
+    st77xx_stats.bytes += size;
+    if (dc != st77xx_last_dc)
+    {
+        st77xx_stats.dc_toggles++;
+        st77xx_last_dc = dc;
+    }
+}
+
+#if ST77XX_HARDWARE_SPI
+spi_device_handle_t spiHander;
+
+static spi_transaction_t st77xx_trans[ST77XX_QUEUE_SIZE];
+static uint8_t st77xx_trans_head = 0;
+static uint8_t st77xx_trans_inflight = 0;
+static ST77XX_DoneCallback st77xx_done_cb = NULL;
+static void *st77xx_done_arg = NULL;
+
+//Pre-built window setup: CASET, x1 x2, RASET, y1 y2, RAMWR. Every transaction carries its
+//payload inline in tx_data, only the coordinates are patched before sending.
+static spi_transaction_t st77xx_win_trans[5] = {
+    { .flags = SPI_TRANS_USE_TXDATA, .length = 8,  .user = (void*)0, .tx_data = { ST77XX_CASET } },
+    { .flags = SPI_TRANS_USE_TXDATA, .length = 32, .user = (void*)ST77XX_TRANS_DC },
+    { .flags = SPI_TRANS_USE_TXDATA, .length = 8,  .user = (void*)0, .tx_data = { ST77XX_RASET } },
+    { .flags = SPI_TRANS_USE_TXDATA, .length = 32, .user = (void*)ST77XX_TRANS_DC },
+    { .flags = SPI_TRANS_USE_TXDATA, .length = 8,  .user = (void*)0, .tx_data = { ST77XX_RAMWR } },
+};
+
+//This function is called (in irq context!) just before a transmission starts. It will
+//set the D/C line to the value indicated in the user field.
+void IRAM_ATTR lcd_spi_pre_transfer_callback(spi_transaction_t *trans)
+{
+    int dc = (int)trans->user & ST77XX_TRANS_DC;
+    gpio_set_level(ST77XX_DC_PIN, dc);
+}
+
+//Called (in irq context too) when a transmission is done. Once the last segment of an
+//async write is out, the caller is told its buffer is free again.
+void IRAM_ATTR lcd_spi_post_transfer_callback(spi_transaction_t *trans)
+{
+    if (((int)trans->user & ST77XX_TRANS_LAST) && st77xx_done_cb)
+    {
+        st77xx_done_cb(st77xx_done_arg);
+    }
+}
+
+static void initSpi()
+{
+    esp_err_t ret;
+    spi_bus_config_t buscfg = {
+        .miso_io_num = -1,
+        .mosi_io_num = ST77XX_MOSI_PIN,
+        .sclk_io_num = ST77XX_SCK_PIN,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = ST77XX_DMA_SEG_SIZE
+    };
+    spi_device_interface_config_t devcfg={
+        .flags = SPI_DEVICE_HALFDUPLEX, // TX only
+        .clock_speed_hz = 40*1000*1000,           //Clock
+        .mode = 0,                                //SPI mode 0
+        .spics_io_num = ST77XX_CS_PIN,               //CS pin
+        .queue_size = ST77XX_QUEUE_SIZE,           //Segments of an async write in flight at a time
+        .pre_cb = lcd_spi_pre_transfer_callback,  //Specify pre-transfer callback to handle D/C line
+        .post_cb = lcd_spi_post_transfer_callback, //Signals the end of an async write
+    };
+    //Initialize the SPI bus
+    ret = spi_bus_initialize(LCD_HOST, &buscfg, SPI_DMA_CH_AUTO);
+    ESP_ERROR_CHECK(ret);
+    //Attach the LCD to the SPI bus
+    ret = spi_bus_add_device(LCD_HOST, &devcfg, &spiHander);
+    ESP_ERROR_CHECK(ret);
+    printf("spi hander: %x\n", (void*)spiHander);
+}
+
+//Take back the oldest queued transaction, blocks until it is done.
+static void ST77XX_ReapTrans(void)
+{
+    spi_transaction_t *rtrans;
+    ESP_ERROR_CHECK(spi_device_get_trans_result(spiHander, &rtrans, portMAX_DELAY));
+    st77xx_trans_inflight--;
+}
+
+static void ST77XX_QueueTrans(const uint8_t *pData, uint32_t Size, int user)
+{
+    spi_transaction_t *t;
+
+    if (st77xx_trans_inflight == ST77XX_QUEUE_SIZE)
+    {
+        ST77XX_ReapTrans();
+    }
+    t = &st77xx_trans[st77xx_trans_head];
+    st77xx_trans_head = (st77xx_trans_head + 1) % ST77XX_QUEUE_SIZE;
+
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length = Size * 8;
+    t->tx_buffer = pData;
+    t->user = (void*)user;
+    ESP_ERROR_CHECK(spi_device_queue_trans(spiHander, t, portMAX_DELAY));
+    st77xx_trans_inflight++;
+    ST77XX_CountTrans(user & ST77XX_TRANS_DC, Size);
+}
+#endif
+
+static void ST77XX_Esp_Wait(void)
+{
+#if ST77XX_HARDWARE_SPI
+    while (st77xx_trans_inflight > 0)
+    {
+        ST77XX_ReapTrans();
+    }
+#endif
+}
+
+static void ST77XX_Esp_Init(void)
+{
+    gpio_config_t io_config = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_down_en = 0,
+        .pull_up_en = 0,
+    };
+
+#if !ST77XX_HARDWARE_SPI
+    printf("init gpio cs sck mosi\n");
+    io_config.pin_bit_mask = (1ULL << ST77XX_CS_PIN)
+                            | (1ULL << ST77XX_SCK_PIN)
+                            | (1ULL << ST77XX_MOSI_PIN)
+                            | (1ULL << ST77XX_DC_PIN)
+                            | (1ULL << ST77XX_RES_PIN)
+                            | (1ULL << ST77XX_BL_PIN);
+#else
+    printf("init spi\n");
+    initSpi();
+    io_config.pin_bit_mask = (1ULL << ST77XX_DC_PIN)
+                            | (1ULL << ST77XX_RES_PIN)
+                            | (1ULL << ST77XX_BL_PIN);
+#endif
+
+    gpio_config(&io_config);
+}
+
+static void ST77XX_TransmitByte(uint8_t dat)
+{
+#if ST77XX_HARDWARE_SPI
+    // Polling transactions can't be mixed with queued ones still in flight
+    ST77XX_Esp_Wait();
+    // ST77XX_CS_LOW;
+    spi_transaction_t t = {
+        .length = 8,
+        .tx_buffer = &dat,
+        .user = (void*)0
+    };
+    ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t));
+    ST77XX_CountTrans(0, 1);
+    // ST77XX_CS_HIGH;
+#else
+    uint8_t i;
+    ST77XX_CS_LOW;
+    for (i = 0; i < 8; i++)
+    {
+        ST77XX_SCK_LOW;
+        if (dat & 0x80)
+        {
+            ST77XX_MOSI_HIGH;
+        }
+        else
+        {
+            ST77XX_MOSI_LOW;
+        }
+        ST77XX_SCK_HIGH;
+        dat <<= 1;
+    }
+    ST77XX_CS_HIGH;
+#endif
+}
+
+static void ST77XX_Transmit(const uint8_t *pData, uint32_t Size)
+{
+#if ST77XX_HARDWARE_SPI
+    uint32_t seg;
+
+    ST77XX_Esp_Wait();
+    //One polling transaction per DMA segment, the bus takes no more than max_transfer_sz
+    while (Size > 0)
+    {
+        seg = Size > ST77XX_DMA_SEG_SIZE ? ST77XX_DMA_SEG_SIZE : Size;
+        spi_transaction_t t = {
+            .length = seg * 8,
+            .tx_buffer = pData,
+            .user = (void*)ST77XX_TRANS_DC
+        };
+        ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t));
+        ST77XX_CountTrans(ST77XX_TRANS_DC, seg);
+        pData += seg;
+        Size -= seg;
+    }
+#else
+    ST77XX_CountTrans(1, Size);
+    while (Size-- > 0)
+    {
+        ST77XX_TransmitByte(*(pData++));
+    }
+#endif
+}
+
+static void ST77XX_Esp_WriteCommand(uint8_t cmd)
+{
+#if ST77XX_HARDWARE_SPI
+    //D/C is set by the pre-transfer callback from t.user, only once the queued data ahead
+    //of the command is out
+    ST77XX_TransmitByte(cmd);
+#else
+    ST77XX_DC_LOW;
+    ST77XX_CountTrans(0, 1);
+    ST77XX_TransmitByte(cmd);
+    ST77XX_DC_HIGH;
+#endif
+}
+
+static void ST77XX_Esp_WriteData(const uint8_t *data, uint32_t size)
+{
+    ST77XX_Transmit(data, size);
+}
+
+static void ST77XX_Esp_WriteDataAsync(const uint8_t *data, uint32_t size, ST77XX_DoneCallback done, void *arg)
+{
+#if ST77XX_HARDWARE_SPI
+    uint32_t seg;
+
+    ST77XX_Esp_Wait();
+    st77xx_done_cb = done;
+    st77xx_done_arg = arg;
+    while (size > 0)
+    {
+        seg = size > ST77XX_DMA_SEG_SIZE ? ST77XX_DMA_SEG_SIZE : size;
+        size -= seg;
+        ST77XX_QueueTrans(data, seg, ST77XX_TRANS_DC | (size == 0 ? ST77XX_TRANS_LAST : 0));
+        data += seg;
+    }
+#else
+    ST77XX_Transmit(data, size);
+    if (done)
+        done(arg);
+#endif
+}
+
+#if ST77XX_HARDWARE_SPI
+//The same DMA buffer queued `count` times, the CPU is free once the last one is queued
+static void ST77XX_Esp_WriteDataRepeat(const uint8_t *data, uint32_t size, uint32_t count)
+{
+    while (count--)
+    {
+        ST77XX_QueueTrans(data, size, ST77XX_TRANS_DC);
+    }
+}
+
+//Sends the pre-built window setup with the bus held, so the per-transaction bus locking
+//is paid once.
+static void ST77XX_Esp_WriteWindow(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, bool caset, bool raset)
+{
+    spi_transaction_t *t = st77xx_win_trans;
+
+    ST77XX_Esp_Wait();
+
+    t[1].tx_data[0] = x1 >> 8;
+    t[1].tx_data[1] = x1 & 0xFF;
+    t[1].tx_data[2] = x2 >> 8;
+    t[1].tx_data[3] = x2 & 0xFF;
+    t[3].tx_data[0] = y1 >> 8;
+    t[3].tx_data[1] = y1 & 0xFF;
+    t[3].tx_data[2] = y2 >> 8;
+    t[3].tx_data[3] = y2 & 0xFF;
+
+    ESP_ERROR_CHECK(spi_device_acquire_bus(spiHander, portMAX_DELAY));
+    if (caset)
+    {
+        ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t[0]));
+        ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t[1]));
+        ST77XX_CountTrans(0, 1);
+        ST77XX_CountTrans(1, 4);
+    }
+    if (raset)
+    {
+        ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t[2]));
+        ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t[3]));
+        ST77XX_CountTrans(0, 1);
+        ST77XX_CountTrans(1, 4);
+    }
+    ESP_ERROR_CHECK(spi_device_polling_transmit(spiHander, &t[4]));
+    spi_device_release_bus(spiHander);
+    ST77XX_CountTrans(0, 1);
+}
+#endif
+
+static void ST77XX_Esp_SetReset(bool level)
+{
+    if (level)
+        ST77XX_RESET_HIGH;
+    else
+        ST77XX_RESET_LOW;
+}
+
+static void ST77XX_Esp_SetBacklight(bool on)
+{
+    if (on)
+        ST77XX_BL_HIGH;
+    else
+        ST77XX_BL_LOW;
+}
+
+static void ST77XX_Esp_DelayMs(uint32_t ms)
+{
+    vTaskDelay(ms / portTICK_RATE_MS);
+}
+
+const ST77XX_Bus_t st77xx_bus_esp = {
+    .init = ST77XX_Esp_Init,
+    .write_command = ST77XX_Esp_WriteCommand,
+    .write_data = ST77XX_Esp_WriteData,
+    .write_data_async = ST77XX_Esp_WriteDataAsync,
+#if ST77XX_HARDWARE_SPI
+    .write_data_repeat = ST77XX_Esp_WriteDataRepeat,
+    .write_window = ST77XX_Esp_WriteWindow,
+#else
+    .write_data_repeat = NULL,
+    .write_window = NULL,
+#endif
+    .wait = ST77XX_Esp_Wait,
+    .set_reset = ST77XX_Esp_SetReset,
+    .set_backlight = ST77XX_Esp_SetBacklight,
+    .delay_ms = ST77XX_Esp_DelayMs,
+};
@@ -0,0 +1,9 @@
+#ifndef __ST77XX_BUS_ESP_H_
+#define __ST77XX_BUS_ESP_H_
+
+#include "st77xx_bus.h"
+
+// SPI2 with DMA, pins from st77xx.h
+extern const ST77XX_Bus_t st77xx_bus_esp;
+
+#endif // __ST77XX_BUS_ESP_H_
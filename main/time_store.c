@@ -0,0 +1,262 @@
+/* Time store
+
+   What the syncs taught about the clock, kept in RTC memory across resets and
+   in NVS across power loss: when the last sync was and the rate error of the
+   clock (clock_disc.c). The rate error is taken out of the system clock
+   continuously, adjtime every TIME_STORE_SLEW_S. The system clock on the C3
+   keeps running through a reset (RTC timer), so after one it is only stepped
+   by the correction it missed. After a power loss it starts from the epoch
+   again, the last known time is the best there is until the next sync. That
+   one is written to NVS every TIME_STORE_SAVE_S, not more, to spare the
+   flash.
+*/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "time_store.h"
+
+static const char *TAG = "time-store";
+
+#define TIME_STORE_MAGIC    0x54494d46
+
+typedef struct {
+    uint32_t magic;
+    int64_t sync_us;        // true time of the last sync, 0 when there is no reference
+    int64_t corrected_us;   // rate correction taken out of the system clock since then
+    int64_t last_us;        // last known time, 0 if never known, for after a power loss
+    int32_t offset_us;      // offset the last sync found, true minus system time
+    clock_disc_t disc;
+    uint32_t crc;           // of everything before it
+} time_store_t;
+
+static RTC_NOINIT_ATTR time_store_t time_store;
+// The syncs come from the lwIP task, the slewing from the esp_timer task
+static SemaphoreHandle_t time_store_lock;
+static esp_timer_handle_t time_store_timer;
+
+static int64_t time_store_now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void time_store_set(int64_t us)
+{
+    struct timeval tv = {.tv_sec = us / 1000000, .tv_usec = us % 1000000};
+
+    settimeofday(&tv, NULL);
+}
+
+// Slew still to come from earlier adjtime calls
+static int64_t time_store_pending_us(void)
+{
+    struct timeval tv;
+
+    adjtime(NULL, &tv);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void time_store_slew(int64_t us)
+{
+    struct timeval tv = {.tv_sec = us / 1000000, .tv_usec = us % 1000000};
+
+    adjtime(&tv, NULL);
+}
+
+static uint32_t time_store_crc(const time_store_t *s)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)s, offsetof(time_store_t, crc));
+}
+
+static bool time_store_valid(const time_store_t *s)
+{
+    return s->magic == TIME_STORE_MAGIC && s->crc == time_store_crc(s);
+}
+
+static void time_store_seal(void)
+{
+    time_store.magic = TIME_STORE_MAGIC;
+    time_store.crc = time_store_crc(&time_store);
+}
+
+static bool time_store_load_nvs(time_store_t *s)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(*s);
+    esp_err_t err;
+
+    if (nvs_open("time_store", NVS_READONLY, &nvs) != ESP_OK)
+        return false;
+    err = nvs_get_blob(nvs, "state", s, &size);
+    nvs_close(nvs);
+    return err == ESP_OK && size == sizeof(*s) && time_store_valid(s);
+}
+
+void time_store_save(void)
+{
+    time_store_t copy;
+    nvs_handle_t nvs;
+    esp_err_t err;
+
+    xSemaphoreTake(time_store_lock, portMAX_DELAY);
+    copy = time_store;
+    xSemaphoreGive(time_store_lock);
+
+    err = nvs_open("time_store", NVS_READWRITE, &nvs);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(nvs, "state", &copy, sizeof(copy));
+        if (err == ESP_OK)
+            err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK)
+        ESP_LOGW(TAG, "Cannot save: %s", esp_err_to_name(err));
+}
+
+// Takes out of the clock the rate correction due since the last call, stepped or slewed
+static void time_store_correct(bool step)
+{
+    int64_t now, due, corr;
+
+    xSemaphoreTake(time_store_lock, portMAX_DELAY);
+    if (time_store.sync_us)
+    {
+        now = time_store_now_us();
+        due = clock_disc_correction(&time_store.disc, now - time_store.sync_us);
+        corr = due - time_store.corrected_us;
+        if (step)
+            time_store_set(now - corr);
+        else if (corr)
+            time_store_slew(time_store_pending_us() - corr);
+        time_store.corrected_us = due;
+        time_store_seal();
+    }
+    xSemaphoreGive(time_store_lock);
+}
+
+static void time_store_slew_cb(void *arg)
+{
+    static uint32_t ticks = 0;
+    bool known;
+
+    time_store_correct(false);
+
+    xSemaphoreTake(time_store_lock, portMAX_DELAY);
+    known = time_store.last_us != 0;
+    if (known)
+    {
+        time_store.last_us = time_store_now_us();
+        time_store_seal();
+    }
+    xSemaphoreGive(time_store_lock);
+
+    // On the esp_timer task, a flash write holds up the other timers for a few ms once an hour
+    if (known && ++ticks >= TIME_STORE_SAVE_S / TIME_STORE_SLEW_S)
+    {
+        ticks = 0;
+        time_store_save();
+    }
+}
+
+int32_t time_store_restore(void)
+{
+    const esp_timer_create_args_t args = {
+        .callback = time_store_slew_cb,
+        .name = "time_store",
+    };
+    int32_t error = TIME_STORE_UNKNOWN;
+
+    time_store_lock = xSemaphoreCreateMutex();
+    if (time_store_valid(&time_store))
+    {
+        // Reset, the clock kept running without the correction
+        time_store_correct(true);
+        error = time_store_error_ms();
+        ESP_LOGI(TAG, "Restored after a reset, rate %d ppb", (int)time_store.disc.freq_ppb);
+    }
+    else if (time_store_load_nvs(&time_store))
+    {
+        // Power loss, how long it lasted is unknown. The last known time is shown until the
+        // next sync, which can't measure the rate against it.
+        time_store_set(time_store.last_us);
+        time_store.sync_us = 0;
+        time_store.corrected_us = 0;
+        clock_disc_lost(&time_store.disc);
+        time_store_seal();
+        ESP_LOGI(TAG, "Restored from NVS, rate %d ppb from %u measurements", (int)time_store.disc.freq_ppb,
+                 time_store.disc.samples);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Nothing stored");
+        memset(&time_store, 0, sizeof(time_store));
+        clock_disc_init(&time_store.disc);
+        time_store_seal();
+    }
+
+    ESP_ERROR_CHECK(esp_timer_create(&args, &time_store_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(time_store_timer, TIME_STORE_SLEW_S * 1000000LL));
+    return error;
+}
+
+void time_store_synced(const struct timeval *tv)
+{
+    int64_t now, pending, sync, offset;
+
+    xSemaphoreTake(time_store_lock, portMAX_DELAY);
+    now = time_store_now_us();
+    pending = time_store_pending_us();
+    sync = tv->tv_sec * 1000000LL + tv->tv_usec;
+
+    // Against the clock with the slew still to come, that is where it is headed
+    offset = sync - now - pending;
+    if (time_store.sync_us)
+        clock_disc_update(&time_store.disc, sync - time_store.sync_us, time_store.corrected_us, offset);
+    if (llabs(sync - now) > TIME_STORE_STEP_US)
+        time_store_set(sync);
+    else
+        time_store_slew(sync - now);
+
+    time_store.sync_us = sync;
+    time_store.last_us = sync;
+    time_store.corrected_us = 0;
+    time_store.offset_us = offset;
+    time_store_seal();
+    ESP_LOGI(TAG, "Offset %lld us, rate %d ppb, next sync in %u s", (long long)offset,
+             (int)time_store.disc.freq_ppb, (unsigned)time_store.disc.interval_s);
+    xSemaphoreGive(time_store_lock);
+}
+
+int32_t time_store_error_ms(void)
+{
+    int64_t ms;
+
+    if (!time_store.sync_us)
+        return TIME_STORE_UNKNOWN;
+    ms = clock_disc_error_us(&time_store.disc, time_store_now_us() - time_store.sync_us) / 1000;
+    return ms < TIME_STORE_UNKNOWN ? ms : TIME_STORE_UNKNOWN;
+}
+
+uint32_t time_store_valid_ms(void)
+{
+    int64_t left;
+
+    if (!time_store.sync_us)
+        return 0;
+    left = (time_store.sync_us + time_store.disc.interval_s * 1000000LL - time_store_now_us()) / 1000;
+    if (left <= 0)
+        return 0;
+    return left < UINT32_MAX ? left : UINT32_MAX;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/time.h>
+#include "clock_disc.h"
+
+// A sync is needed once the estimated error of the clock goes past this
+#define TIME_STORE_MAX_ERROR_MS     (CLOCK_DISC_MAX_ERROR_US / 1000)
+// The rate correction is slewed in this often
+#define TIME_STORE_SLEW_S           16
+// The last known time goes to NVS this often, it is what a power loss goes back to
+#define TIME_STORE_SAVE_S           3600
+// A sync steps the clock by more than this, less is slewed (adjtime, a second per minute)
+#define TIME_STORE_STEP_US          1000000
+// Estimated error of a clock that can't be trusted
+#define TIME_STORE_UNKNOWN          INT32_MAX
+
+// Sets the clock at boot from what the last sync left and starts taking the measured rate
+// error out of it. After a reset the system clock has kept running and is only stepped by
+// the correction it missed, after a power loss it is set to the last known time, at most
+// TIME_STORE_SAVE_S old, and the error is TIME_STORE_UNKNOWN. Returns the estimated error in ms. NVS must be initialized.
+int32_t time_store_restore(void);
+// Moves the clock to `tv` from a sync and learns from how far off it was. Only kept in RTC
+// memory, time_store_save writes it to NVS too.
+void time_store_synced(const struct timeval *tv);
+void time_store_save(void);
+// Estimated error of the clock now in ms
+int32_t time_store_error_ms(void);
+// ms until the next sync planned by the clock discipline, 0 if it is due
+uint32_t time_store_valid_ms(void);
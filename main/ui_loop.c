@@ -0,0 +1,86 @@
+/* UI loop
+
+   Runs the LVGL timers and then sleeps until the deadline lv_timer_handler
+   returns, or until an event is posted, instead of polling
+   every tick. LVGL pauses its animation timer when nothing animates and the
+   refresh timer when nothing is invalid, so the deadline follows what is on
+   screen: full rate during animations, the clock timer period otherwise.
+*/
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include "bench.h"
+#include "ui_loop.h"
+
+static const char *TAG = "ui-loop";
+
+static TaskHandle_t ui_loop_task = NULL;
+// Events posted before the loop started
+static uint32_t ui_loop_early = 0;
+static portMUX_TYPE ui_loop_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void ui_loop_post(uint32_t events)
+{
+    TaskHandle_t task;
+
+    portENTER_CRITICAL_SAFE(&ui_loop_lock);
+    task = ui_loop_task;
+    if (!task)
+        ui_loop_early |= events;
+    portEXIT_CRITICAL_SAFE(&ui_loop_lock);
+    if (task)
+        xTaskNotify(task, events, eSetBits);
+}
+
+// Rounded up, a deadline shorter than a tick must not turn into a busy loop
+static TickType_t ui_loop_ticks(uint32_t ms)
+{
+    if (ms == LV_NO_TIMER_READY)
+        return portMAX_DELAY;
+    return (ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+}
+
+void ui_loop_run(ui_loop_event_cb_t cb)
+{
+    uint32_t events, wait, wakeups = 0;
+    int64_t start, now, idle = 0, report;
+
+    portENTER_CRITICAL(&ui_loop_lock);
+    ui_loop_task = xTaskGetCurrentTaskHandle();
+    events = ui_loop_early;
+    portEXIT_CRITICAL(&ui_loop_lock);
+    report = esp_timer_get_time();
+
+    while (1)
+    {
+        if (events && cb)
+            cb(events);
+#if CLOCK_BENCH
+        start = esp_timer_get_time();
+        wait = lv_timer_handler();
+        bench_ui_busy(esp_timer_get_time() - start);
+#else
+        wait = lv_timer_handler();
+#endif
+
+        start = esp_timer_get_time();
+        events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, ui_loop_ticks(wait));
+        now = esp_timer_get_time();
+        idle += now - start;
+        wakeups++;
+
+        if (UI_LOOP_REPORT_MS && now - report >= UI_LOOP_REPORT_MS * 1000LL)
+        {
+            ESP_LOGI(TAG, "%u wakeups/s, %u%% idle",
+                     (unsigned)(wakeups * 1000000LL / (now - report)),
+                     (unsigned)(idle * 100 / (now - report)));
+            wakeups = 0;
+            idle = 0;
+            report = now;
+        }
+    }
+}
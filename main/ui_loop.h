@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Events that wake the UI loop before its next LVGL deadline
+#define UI_LOOP_EVENT_INPUT (1 << 0)
+#define UI_LOOP_EVENT_TIME  (1 << 1)
+#define UI_LOOP_EVENT_PANEL (1 << 2)
+#define UI_LOOP_EVENT_SYNC  (1 << 3)
+
+// Log wakeups per second and idle time of the UI task every this many ms, 0 for never
+#define UI_LOOP_REPORT_MS   10000
+
+// Called on the UI task with the UI_LOOP_EVENT_* bits posted since the last wakeup,
+// before the LVGL timers run
+typedef void (*ui_loop_event_cb_t)(uint32_t events);
+
+// Runs LVGL on the calling task, never returns
+void ui_loop_run(ui_loop_event_cb_t cb);
+// Wakes the UI loop from any task. Events posted before ui_loop_run has started are
+// handed to the callback when it does.
+void ui_loop_post(uint32_t events);
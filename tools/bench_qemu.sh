@@ -0,0 +1,46 @@
+#!/bin/sh
+# Builds the benchmark firmware (bench/) with the null display bus, runs it under
+# Espressif's QEMU for the ESP32-C3 and writes the JSON lines it prints. Exits non-zero
+# if the run crashes or doesn't finish in time, so it can gate merges. With -icount the
+# emulated CPU runs a fixed number of instructions per emulated second, the numbers are
+# the same from run to run and only move when the code does.
+#
+#   tools/bench_qemu.sh [results.jsonl]
+#
+# Needs the ESP-IDF environment (export.sh) and qemu-system-riscv32 built from
+# https://github.com/espressif/qemu on the PATH. BENCH_QEMU_TIMEOUT is in seconds.
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=$ROOT/bench/build-qemu
+LOG=$BUILD/console.log
+OUT=${1:-$BUILD/results.jsonl}
+TIMEOUT=${BENCH_QEMU_TIMEOUT:-900}
+
+idf.py -C "$ROOT/bench" -B "$BUILD" -D IDF_TARGET=esp32c3 -D SDKCONFIG="$BUILD/sdkconfig" \
+    -D SDKCONFIG_DEFAULTS="$ROOT/sdkconfig;$ROOT/bench/sdkconfig.defaults;$ROOT/bench/sdkconfig.qemu" \
+    build
+(cd "$BUILD" && esptool.py --chip esp32c3 merge_bin --fill-flash-size 2MB -o flash.bin @flash_args)
+
+rm -f "$LOG"
+qemu-system-riscv32 -machine esp32c3 -icount 3 -display none -monitor none \
+    -drive file="$BUILD/flash.bin",if=mtd,format=raw -serial file:"$LOG" &
+QEMU=$!
+trap 'kill $QEMU 2>/dev/null || true' EXIT
+
+elapsed=0
+while ! grep -q '^{"done":true}' "$LOG" 2>/dev/null; do
+    if grep -q 'Guru Meditation\|abort()' "$LOG" 2>/dev/null; then
+        echo "bench crashed, see $LOG" >&2
+        exit 1
+    fi
+    if [ $elapsed -ge "$TIMEOUT" ] || ! kill -0 $QEMU 2>/dev/null; then
+        echo "bench did not finish in ${TIMEOUT}s, see $LOG" >&2
+        exit 1
+    fi
+    sleep 1
+    elapsed=$((elapsed + 1))
+done
+
+grep '^{' "$LOG" | tr -d '\r' > "$OUT"
+cat "$OUT"
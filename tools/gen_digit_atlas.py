@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Pre-renders the clock characters of an LVGL font into an RGB565 atlas.
+
+Reads a font C file written by lv_font_conv (plain 4 bpp bitmaps, the format
+of the fonts built into LVGL) and writes a C file defining `clock_atlas`, see
+main/clock_atlas.h. Every character of CLOCK_ATLAS_CHARS gets a cell as high as
+the font line, the digits all as wide as the widest one, with the glyph
+blended against the background the way LVGL would draw it. The clock widget
+then copies cells into the draw buffer instead of rendering text.
+
+    gen_digit_atlas.py lv_font_montserrat_22.c clock_atlas.c \
+        --fg 0x00a000 --bg 0xf5f5f5 --swap
+"""
+import argparse
+import re
+import sys
+
+CHARS = "0123456789:."
+
+
+def parse_font(path):
+    with open(path, encoding="utf-8") as f:
+        src = f.read()
+
+    def field(name, text=src):
+        m = re.search(r"\." + name + r"\s*=\s*(-?\d+)", text)
+        if not m:
+            sys.exit("%s: no .%s" % (path, name))
+        return int(m.group(1))
+
+    if field("bpp") != 4 or field("bitmap_format") != 0:
+        sys.exit("%s: only uncompressed 4 bpp fonts are supported" % path)
+
+    m = re.search(r"glyph_bitmap\[\]\s*=\s*\{(.*?)\};", src, re.S)
+    body = re.sub(r"/\*.*?\*/", "", m.group(1), flags=re.S)
+    bitmap = [int(v, 16) for v in re.findall(r"0x[0-9a-fA-F]+", body)]
+
+    m = re.search(r"glyph_dsc\[\]\s*=\s*\{(.*?)\};", src, re.S)
+    glyphs = []
+    for entry in re.findall(r"\{([^{}]*)\}", m.group(1)):
+        glyphs.append({k: field(k, entry) for k in
+                       ("bitmap_index", "adv_w", "box_w", "box_h", "ofs_x", "ofs_y")})
+
+    # The clock characters are all in the first, ASCII range
+    m = re.search(r"cmaps\[\]\s*=\s*\{(.*?)\};", src, re.S)
+    start, length, first_id = (field(k, m.group(1)) for k in
+                               ("range_start", "range_length", "glyph_id_start"))
+
+    font = {"line_height": field("line_height"), "base_line": field("base_line"), "glyphs": {}}
+    for c in CHARS:
+        cp = ord(c)
+        if not start <= cp < start + length:
+            sys.exit("%s: %r is not in the first range" % (path, c))
+        font["glyphs"][c] = glyphs[cp - start + first_id]
+    font["bitmap"] = bitmap
+    return font
+
+
+def rgb565(rgb):
+    return (rgb >> 19) & 0x1F, (rgb >> 10) & 0x3F, (rgb >> 3) & 0x1F
+
+
+# lv_color_mix() on the 565 channels, the same rounding as LVGL
+def mix(fg, bg, opa):
+    if opa >= 253:
+        return fg
+    if opa <= 2:
+        return bg
+    return tuple(((f * opa + b * (255 - opa) + 128) * 0x8081) >> 23 for f, b in zip(fg, bg))
+
+
+def pack(ch, swap):
+    v = (ch[0] << 11) | (ch[1] << 5) | ch[2]
+    return ((v & 0xFF) << 8) | (v >> 8) if swap else v
+
+
+def render(font, fg, bg, swap):
+    height = font["line_height"]
+    adv = {c: (g["adv_w"] + 8) >> 4 for c, g in font["glyphs"].items()}
+    digit_w = max(adv[c] for c in "0123456789")
+
+    cells, pixels = [], []
+    for c in CHARS:
+        g = font["glyphs"][c]
+        w = digit_w if c.isdigit() else adv[c]
+        # Centered in the cell, on the baseline, where an LVGL label puts it
+        x0 = (w - adv[c]) // 2 + g["ofs_x"]
+        y0 = height - font["base_line"] - g["box_h"] - g["ofs_y"]
+        cell = [[bg] * w for _ in range(height)]
+        for i in range(g["box_w"] * g["box_h"]):
+            byte = font["bitmap"][g["bitmap_index"] + i // 2]
+            v = (byte >> 4) if i % 2 == 0 else (byte & 0x0F)
+            x, y = x0 + i % g["box_w"], y0 + i // g["box_w"]
+            if 0 <= x < w and 0 <= y < height:
+                cell[y][x] = mix(fg, bg, v * 17)
+        cells.append((w, len(pixels)))
+        pixels.extend(pack(p, swap) for row in cell for p in row)
+    return height, cells, pixels
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("font", help="lv_font_conv C file, e.g. lv_font_montserrat_22.c")
+    ap.add_argument("output", help="C file to write")
+    ap.add_argument("--fg", type=lambda s: int(s, 0), required=True, help="text color, 0xRRGGBB")
+    ap.add_argument("--bg", type=lambda s: int(s, 0), required=True, help="background color, 0xRRGGBB")
+    ap.add_argument("--swap", action="store_true", help="bytes swapped, for LV_COLOR_16_SWAP")
+    args = ap.parse_args()
+
+    font = parse_font(args.font)
+    height, cells, pixels = render(font, rgb565(args.fg), rgb565(args.bg), args.swap)
+
+    out = ["// Generated by tools/gen_digit_atlas.py from %s, do not edit"
+           % args.font.replace("\\", "/").split("/")[-1],
+           "#include \"clock_atlas.h\"", "",
+           "static const uint16_t clock_atlas_pixels[%d] = {" % len(pixels)]
+    for i in range(0, len(pixels), 12):
+        out.append("    " + ", ".join("0x%04X" % p for p in pixels[i:i + 12]) + ",")
+    out += ["};", "",
+            "const clock_atlas_t clock_atlas = {",
+            "    .height = %d," % height,
+            "    .fg = 0x%06X," % args.fg,
+            "    .bg = 0x%06X," % args.bg,
+            "    .cells = {"]
+    out += ["        {%d, %d},  // '%s'" % (w, off, c) for (w, off), c in zip(cells, CHARS)]
+    out += ["    },", "    .pixels = clock_atlas_pixels,", "};", ""]
+
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
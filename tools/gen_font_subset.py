@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""Cuts an LVGL font down to the characters the UI uses.
+
+Scans the string literals of the given C sources, keeps the code points the
+source font has, and writes a new LVGL 8 font with only those glyphs. Runs of
+three or more consecutive code points get a FORMAT0_TINY range, where the
+glyph id is a subtraction, the rest share one SPARSE_TINY list. The source
+must be an lv_font_conv C file with plain bitmaps (the fonts built into LVGL).
+Kerning is dropped, the CJK fonts don't have any.
+
+    gen_font_subset.py lv_font_simsun_16_cjk.c clock_font_date.c \
+        clock_font_date_subset main/clock_fmt.c
+"""
+import argparse
+import re
+import sys
+
+
+def strip_comments(text):
+    return re.sub(r"/\*.*?\*/|//[^\n]*", "", text, flags=re.S)
+
+
+def array(src, name):
+    m = re.search(r"\b" + re.escape(name) + r"\[\]\s*=\s*\{(.*?)\};", src, re.S)
+    if not m:
+        sys.exit("no array %s" % name)
+    return m.group(1)
+
+
+def numbers(text):
+    return [int(v, 0) for v in re.findall(r"-?(?:0x[0-9a-fA-F]+|\d+)", strip_comments(text))]
+
+
+def field(text, name, default=None):
+    m = re.search(r"\." + name + r"\s*=\s*([-\w]+)", text)
+    if not m:
+        if default is None:
+            sys.exit("no .%s" % name)
+        return default
+    v = m.group(1)
+    return int(v, 0) if re.match(r"-?\d", v) else v
+
+
+def parse_font(path):
+    with open(path, encoding="utf-8") as f:
+        src = f.read()
+    if field(src, "bitmap_format") != 0:
+        sys.exit("%s: compressed fonts are not supported" % path)
+
+    font = {
+        "bpp": field(src, "bpp"),
+        "line_height": field(src, "line_height"),
+        "base_line": field(src, "base_line"),
+        "underline_position": field(src, "underline_position", 0),
+        "underline_thickness": field(src, "underline_thickness", 0),
+        "bitmap": numbers(array(src, "glyph_bitmap")),
+        "glyphs": [],
+        "map": {},
+    }
+    for entry in re.findall(r"\{([^{}]*)\}", strip_comments(array(src, "glyph_dsc"))):
+        font["glyphs"].append({k: field(entry, k) for k in
+                               ("bitmap_index", "adv_w", "box_w", "box_h", "ofs_x", "ofs_y")})
+
+    # Code point to glyph id, through every cmap type
+    for cmap in re.findall(r"\{([^{}]*)\}", strip_comments(array(src, "cmaps"))):
+        start, length = field(cmap, "range_start"), field(cmap, "range_length")
+        first, kind = field(cmap, "glyph_id_start"), field(cmap, "type")
+        ulist, olist = field(cmap, "unicode_list"), field(cmap, "glyph_id_ofs_list")
+        ofs = numbers(array(src, olist)) if olist != "NULL" else None
+        if kind.endswith("FORMAT0_TINY"):
+            pairs = [(start + i, first + i) for i in range(length)]
+        elif kind.endswith("FORMAT0_FULL"):
+            pairs = [(start + i, first + ofs[i]) for i in range(length)]
+        else:
+            codes = numbers(array(src, ulist))
+            pairs = [(start + c, first + (ofs[i] if kind.endswith("SPARSE_FULL") else i))
+                     for i, c in enumerate(codes)]
+        for cp, gid in pairs:
+            if gid:
+                font["map"][cp] = gid
+    return font
+
+
+def glyph_bytes(font, g):
+    return (g["box_w"] * g["box_h"] * font["bpp"] + 7) // 8
+
+
+def font_size(font, glyphs, cmap_bytes):
+    # Flash of the bitmaps, the 8 byte glyph descriptors and the cmap data
+    return sum(glyph_bytes(font, g) for g in glyphs) + 8 * (len(glyphs) + 1) + cmap_bytes
+
+
+def scan(paths):
+    cps = set()
+    for path in paths:
+        with open(path, encoding="utf-8") as f:
+            src = re.sub(r"^\s*#\s*include[^\n]*", "", strip_comments(f.read()), flags=re.M)
+        for lit in re.findall(r'"((?:[^"\\\n]|\\.)*)"', src):
+            # Escapes are control characters, never drawn
+            cps.update(ord(c) for c in re.sub(r"\\.", "", lit))
+    return cps
+
+
+def cmaps_for(cps):
+    """Runs of 3+ consecutive code points as ranges, everything else in one sparse list"""
+    ranges, rest, run = [], [], [cps[0]]
+    for cp in cps[1:] + [None]:
+        if cp is not None and cp == run[-1] + 1:
+            run.append(cp)
+            continue
+        if len(run) >= 3:
+            ranges.append(run)
+        else:
+            rest.extend(run)
+        run = [cp]
+    return ranges, rest
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("font", help="lv_font_conv C file to cut down")
+    ap.add_argument("output", help="C file to write")
+    ap.add_argument("name", help="name of the lv_font_t")
+    ap.add_argument("sources", nargs="+", help="C files whose string literals are scanned")
+    args = ap.parse_args()
+
+    font = parse_font(args.font)
+    cps = sorted(cp for cp in scan(args.sources) if cp in font["map"])
+    if not cps:
+        sys.exit("none of the characters are in %s" % args.font)
+    ranges, rest = cmaps_for(cps)
+
+    # Glyphs in cmap order: the ranges, then the sparse list
+    order = [cp for run in ranges for cp in run] + rest
+    glyphs, bitmap = [], []
+    for cp in order:
+        g = dict(font["glyphs"][font["map"][cp]])
+        n = glyph_bytes(font, g)
+        data = font["bitmap"][g["bitmap_index"]:g["bitmap_index"] + n]
+        g["bitmap_index"] = len(bitmap)
+        bitmap.extend(data)
+        glyphs.append((cp, g))
+
+    # The cmap lists of the source are left out of its size, they are small next to the bitmaps
+    full = font_size(font, font["glyphs"][1:], 0)
+    subset = font_size(font, [g for _, g in glyphs], 2 * len(rest))
+
+    out = ["// Generated by tools/gen_font_subset.py from %s, do not edit"
+           % args.font.replace("\\", "/").split("/")[-1],
+           "// %d of %d glyphs, about %d of %d bytes of flash" % (len(glyphs), len(font["glyphs"]) - 1,
+                                                                 subset, full),
+           '#include "lvgl.h"', "",
+           "static LV_ATTRIBUTE_LARGE_CONST const uint8_t glyph_bitmap[] = {"]
+    for i in range(0, len(bitmap), 16):
+        out.append("    " + ", ".join("0x%02x" % b for b in bitmap[i:i + 16]) + ",")
+    out += ["};", "", "static const lv_font_fmt_txt_glyph_dsc_t glyph_dsc[] = {",
+            "    {.bitmap_index = 0, .adv_w = 0, .box_w = 0, .box_h = 0, .ofs_x = 0, .ofs_y = 0},"]
+    for cp, g in glyphs:
+        out.append("    {.bitmap_index = %d, .adv_w = %d, .box_w = %d, .box_h = %d, .ofs_x = %d, .ofs_y = %d},"
+                   "  // U+%04X %s" % (g["bitmap_index"], g["adv_w"], g["box_w"], g["box_h"],
+                                      g["ofs_x"], g["ofs_y"], cp, chr(cp) if cp > 0x20 else "' '"))
+    out.append("};")
+
+    cmaps, gid = [], 1
+    for run in ranges:
+        cmaps.append("    {.range_start = %d, .range_length = %d, .glyph_id_start = %d, .unicode_list = NULL,"
+                     " .glyph_id_ofs_list = NULL, .list_length = 0, .type = LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY},"
+                     % (run[0], len(run), gid))
+        gid += len(run)
+    if rest:
+        out += ["", "static const uint16_t unicode_list[] = {",
+                "    " + ", ".join("0x%x" % (cp - rest[0]) for cp in rest) + ",", "};"]
+        cmaps.append("    {.range_start = %d, .range_length = %d, .glyph_id_start = %d, .unicode_list = unicode_list,"
+                     " .glyph_id_ofs_list = NULL, .list_length = %d, .type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY},"
+                     % (rest[0], rest[-1] - rest[0] + 1, gid, len(rest)))
+    out += ["", "static const lv_font_fmt_txt_cmap_t cmaps[] = {"] + cmaps + ["};", ""]
+
+    out += ["static lv_font_fmt_txt_glyph_cache_t cache;",
+            "",
+            "static const lv_font_fmt_txt_dsc_t font_dsc = {",
+            "    .glyph_bitmap = glyph_bitmap,",
+            "    .glyph_dsc = glyph_dsc,",
+            "    .cmaps = cmaps,",
+            "    .kern_dsc = NULL,",
+            "    .kern_scale = 0,",
+            "    .cmap_num = %d," % len(cmaps),
+            "    .bpp = %d," % font["bpp"],
+            "    .kern_classes = 0,",
+            "    .bitmap_format = 0,",
+            "    .cache = &cache,",
+            "};",
+            "",
+            "const lv_font_t %s = {" % args.name,
+            "    .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,",
+            "    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,",
+            "    .line_height = %d," % font["line_height"],
+            "    .base_line = %d," % font["base_line"],
+            "    .subpx = LV_FONT_SUBPX_NONE,",
+            "    .underline_position = %d," % font["underline_position"],
+            "    .underline_thickness = %d," % font["underline_thickness"],
+            "    .dsc = &font_dsc,",
+            "};",
+            ""]
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("\n".join(out))
+    print("%s: %d of %d glyphs, about %d of %d bytes of flash"
+          % (args.name, len(glyphs), len(font["glyphs"]) - 1, subset, full))
+
+
+if __name__ == "__main__":
+    main()